@@ -0,0 +1,79 @@
+// Bulk load and hinted insert from sorted keys against the insert loop of main.cpp
+#include "radix_tree.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    std::vector<std::pair<std::string, int>> make_sorted_keys(const std::size_t count) {
+        // url like keys sharing long prefixes
+        std::mt19937_64 rng{42};
+        const char* hosts[] = {"https://example.com/", "https://example.org/api/v1/", "https://cdn.example.net/static/"};
+        std::vector<std::pair<std::string, int>> keys;
+        keys.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            keys.emplace_back(std::string(hosts[rng() % 3]) + "users/" + std::to_string(rng() % 100000) + "/items/" + std::to_string(i), static_cast<int>(i));
+        }
+
+        std::sort(keys.begin(), keys.end());
+
+        // copy so that the strings sit in memory in key order, like keys streamed from a sorted file
+        return std::vector<std::pair<std::string, int>>(keys.begin(), keys.end());
+    }
+
+    template <typename Function>
+    double measure_ms(Function function) {
+        // best of a few runs, the first one mostly measures page faults of the fresh heap
+        double best_ms = 0;
+        for (int run = 0; run < 3; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best_ms = (run == 0 || elapsed_ms < best_ms) ? elapsed_ms : best_ms;
+        }
+        return best_ms;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    auto keys = make_sorted_keys(count);
+
+    std::size_t insert_size = 0;
+    double insert_ms = measure_ms([&] {
+        radix_tree<std::string, int> radix_tree;
+        for (auto& key : keys) {
+            radix_tree.insert(key);
+        }
+        insert_size = radix_tree.size();
+    });
+
+    std::size_t hinted_size = 0;
+    double hinted_ms = measure_ms([&] {
+        radix_tree<std::string, int> radix_tree;
+        auto hint = radix_tree.end();
+        for (auto& key : keys) {
+            hint = radix_tree.insert(hint, key);
+        }
+        hinted_size = radix_tree.size();
+    });
+
+    std::size_t assign_size = 0;
+    double assign_ms = measure_ms([&] {
+        radix_tree<std::string, int> radix_tree(keys.begin(), keys.end());
+        assign_size = radix_tree.size();
+    });
+
+    std::cout << "keys: " << count << std::endl;
+    std::cout << "insert loop: " << insert_ms << " ms (" << insert_size << " keys)" << std::endl;
+    std::cout << "hinted:      " << hinted_ms << " ms (" << hinted_size << " keys)" << std::endl;
+    std::cout << "bulk load:   " << assign_ms << " ms (" << assign_size << " keys)" << std::endl;
+    std::cout << "speedup:     " << insert_ms / assign_ms << "x" << std::endl;
+    return insert_size == assign_size && hinted_size == assign_size ? 0 : 1;
+}
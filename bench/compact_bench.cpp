@@ -0,0 +1,86 @@
+// Scan and lookup times of a churned tree before and after compact(), and the memory it gives back
+#include "radix_tree.h"
+#include "radix_tree_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    using pool_tree = radix_tree<std::string, int, split<std::string>, radix_len<std::string>,
+                                 radix_tree_pool_allocator<std::pair<const std::string, int>>>;
+
+    std::string make_key(std::mt19937_64& rng) {
+        const char* hosts[] = {"https://example.com/", "https://example.org/api/v1/", "https://cdn.example.net/static/"};
+        return std::string(hosts[rng() % 3]) + "users/" + std::to_string(rng() % 1000000) + "/items/" + std::to_string(rng() % 1000);
+    }
+
+    template <typename Function>
+    double measure_ms(Function function) {
+        double best_ms = 0;
+        for (int run = 0; run < 3; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best_ms = (run == 0 || elapsed_ms < best_ms) ? elapsed_ms : best_ms;
+        }
+        return best_ms;
+    }
+
+    void report(const char* title, pool_tree& tree, const std::vector<std::string>& probes) {
+        long sum = 0;
+        double scan_ms = measure_ms([&] {
+            for (auto it = tree.begin(); it != tree.end(); ++it) {
+                sum += it->second;
+            }
+        });
+        double find_ms = measure_ms([&] {
+            for (auto& probe : probes) {
+                auto it = tree.find(probe);
+                sum += it != tree.end() ? it->second : 0;
+            }
+        });
+
+        std::cout << title << " scan: " << scan_ms << " ms, find: " << find_ms << " ms, pool: "
+                  << tree.get_allocator().get_pool()->allocated_bytes() / 1024 << " KiB, live: "
+                  << tree.stats().total_bytes() / 1024 << " KiB (" << (sum & 1) << ")" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500000;
+
+    // grow the tree to twice its final size, then erase at random: the survivors are scattered over the pool
+    std::mt19937_64 rng{42};
+    std::vector<std::string> keys;
+    keys.reserve(2 * count);
+    pool_tree tree;
+    for (std::size_t i = 0; i < 2 * count; ++i) {
+        keys.push_back(make_key(rng));
+        tree.insert({keys.back(), static_cast<int>(i)});
+    }
+    for (std::size_t i = 0; i < 2 * count; ++i) {
+        if (rng() % 2) {
+            tree.erase(keys[i]);
+        }
+    }
+
+    std::vector<std::string> probes;
+    probes.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        probes.push_back(keys[rng() % keys.size()]);
+    }
+
+    std::cout << "keys: " << tree.size() << std::endl;
+    report("churned:  ", tree, probes);
+    double compact_ms = measure_ms([&] {
+        tree.compact();
+    });
+    report("compacted:", tree, probes);
+    std::cout << "compact:    " << compact_ms << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Lookup throughput of concurrent_radix_tree against radix_tree behind a global mutex, by number of threads
+#include "concurrent_radix_tree.h"
+#include "radix_tree.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    std::vector<std::string> make_keys(const std::size_t count) {
+        // url like keys sharing long prefixes
+        std::mt19937_64 rng{42};
+        const char* hosts[] = {"https://example.com/", "https://example.org/api/v1/", "https://cdn.example.net/static/"};
+        std::vector<std::string> keys;
+        keys.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            keys.push_back(std::string(hosts[rng() % 3]) + "users/" + std::to_string(rng() % 100000) + "/items/" + std::to_string(i));
+        }
+        return keys;
+    }
+
+    template <typename Operation>
+    double measure_mops(const unsigned thread_count, const std::chrono::milliseconds duration, Operation operation) {
+        // every thread runs operation(thread, i) in a loop until the time is up, returns millions of operations per second
+        std::atomic<bool> started{false};
+        std::atomic<bool> stopped{false};
+        std::atomic<std::size_t> total_operations{0};
+        std::vector<std::thread> threads;
+        for (unsigned thread = 0; thread < thread_count; ++thread) {
+            threads.emplace_back([&, thread] {
+                while (!started.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+
+                std::size_t operations = 0;
+                while (!stopped.load(std::memory_order_relaxed)) {
+                    for (int i = 0; i < 256; ++i, ++operations) {
+                        operation(thread, operations);
+                    }
+                }
+                total_operations.fetch_add(operations);
+            });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        started.store(true, std::memory_order_release);
+        std::this_thread::sleep_for(duration);
+        stopped.store(true);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        return total_operations.load() / elapsed_us;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    unsigned max_threads = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : std::thread::hardware_concurrency();
+    max_threads = max_threads == 0 ? 1 : max_threads;
+    std::chrono::milliseconds duration{500};
+    auto keys = make_keys(count);
+
+    radix_tree<std::string, int> locked_tree;
+    std::mutex tree_mutex;
+    concurrent_radix_tree<std::string, int> concurrent_tree;
+    for (std::size_t i = 0; i < count; ++i) {
+        locked_tree.insert({keys[i], static_cast<int>(i)});
+        concurrent_tree.insert({keys[i], static_cast<int>(i)});
+    }
+
+    // threads look up keys in different orders
+    auto key_index = [count](const unsigned thread, const std::size_t i) {
+        return (i * 2654435761u + thread * 40503u) % count;
+    };
+
+    std::size_t found = 0;
+    std::cout << "keys: " << count << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "threads  mutex radix_tree Mops/s  concurrent_radix_tree Mops/s  scaling" << std::endl;
+    double single_thread_mops = 0;
+    for (unsigned thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        double locked_mops = measure_mops(thread_count, duration, [&](const unsigned thread, const std::size_t i) {
+            std::lock_guard<std::mutex> lock{tree_mutex};
+            found += locked_tree.find(keys[key_index(thread, i)]) != locked_tree.end();
+        });
+        double concurrent_mops = measure_mops(thread_count, duration, [&](const unsigned thread, const std::size_t i) {
+            if (!concurrent_tree.find(keys[key_index(thread, i)])) {
+                std::abort();
+            }
+        });
+        single_thread_mops = thread_count == 1 ? concurrent_mops : single_thread_mops;
+        std::cout << thread_count << "        " << locked_mops << "                    " << concurrent_mops
+                  << "                          " << concurrent_mops / single_thread_mops << "x" << std::endl;
+    }
+
+    // readers while one thread keeps inserting and erasing keys of its own
+    unsigned reader_count = max_threads > 1 ? max_threads - 1 : 1;
+    double mixed_mops = measure_mops(reader_count + 1, duration, [&](const unsigned thread, const std::size_t i) {
+        if (thread == reader_count) {
+            std::string key = "writer/" + std::to_string(i % 1024);
+            if (i & 1024) {
+                concurrent_tree.erase(key);
+            } else {
+                concurrent_tree.insert({key, 0});
+            }
+        } else if (!concurrent_tree.find(keys[key_index(thread, i)])) {
+            std::abort();
+        }
+    });
+    std::cout << reader_count << " readers + 1 writer: " << mixed_mops << " Mops/s" << std::endl;
+    return found > 0 ? 0 : 1;
+}
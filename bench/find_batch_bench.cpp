@@ -0,0 +1,85 @@
+// Batched lookups against one find per key, on a tree larger than the last level cache
+#include "radix_tree.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    std::vector<std::string> make_keys(const std::size_t count) {
+        // url like keys sharing long prefixes
+        std::mt19937_64 rng{42};
+        const char* hosts[] = {"https://example.com/", "https://example.org/api/v1/", "https://cdn.example.net/static/"};
+        std::vector<std::string> keys;
+        keys.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            keys.push_back(std::string(hosts[rng() % 3]) + "users/" + std::to_string(rng() % 100000) + "/items/" + std::to_string(i));
+        }
+        return keys;
+    }
+
+    template <typename Function>
+    double measure_ms(Function function) {
+        double best_ms = 0;
+        for (int run = 0; run < 3; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best_ms = (run == 0 || elapsed_ms < best_ms) ? elapsed_ms : best_ms;
+        }
+        return best_ms;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+    std::size_t batch_size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 256;
+    auto keys = make_keys(count);
+
+    using tree_type = radix_tree<std::string, int>;
+    tree_type radix_tree;
+    for (std::size_t i = 0; i < count; ++i) {
+        radix_tree.insert({keys[i], static_cast<int>(i)});
+    }
+
+    // half of the lookups miss, all in random order
+    std::vector<std::string> lookups;
+    lookups.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        lookups.push_back(i % 2 ? keys[i] : keys[i] + "?");
+    }
+    std::shuffle(lookups.begin(), lookups.end(), std::mt19937_64{7});
+
+    std::vector<tree_type::iterator> results(batch_size);
+    long find_sum = 0;
+    double find_ms = measure_ms([&] {
+        find_sum = 0;
+        for (auto& key : lookups) {
+            auto it = radix_tree.find(key);
+            find_sum += it != radix_tree.end() ? it.value() : -1;
+        }
+    });
+
+    long batch_sum = 0;
+    double batch_ms = measure_ms([&] {
+        batch_sum = 0;
+        for (std::size_t start = 0; start < lookups.size(); start += batch_size) {
+            auto batch_end = lookups.begin() + std::min(lookups.size(), start + batch_size);
+            auto results_end = radix_tree.find_batch(lookups.begin() + start, batch_end, results.begin());
+            for (auto it = results.begin(); it != results_end; ++it) {
+                batch_sum += *it != radix_tree.end() ? it->value() : -1;
+            }
+        }
+    });
+
+    std::cout << "keys: " << count << ", batch size: " << batch_size << std::endl;
+    std::cout << "find loop:  " << find_ms * 1e6 / count << " ns/lookup" << std::endl;
+    std::cout << "find_batch: " << batch_ms * 1e6 / count << " ns/lookup" << std::endl;
+    std::cout << "speedup:    " << find_ms / batch_ms << "x" << std::endl;
+    return find_sum == batch_sum ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// Startup and lookups of a memory mapped frozen image against rebuilding the tree with insert
+#include "frozen_radix_tree.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    std::vector<std::string> make_keys(const std::size_t count) {
+        // url like keys sharing long prefixes
+        std::mt19937_64 rng{42};
+        const char* hosts[] = {"https://example.com/", "https://example.org/api/v1/", "https://cdn.example.net/static/"};
+        std::vector<std::string> keys;
+        keys.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            keys.push_back(std::string(hosts[rng() % 3]) + "users/" + std::to_string(rng() % 100000) + "/items/" + std::to_string(i));
+        }
+        return keys;
+    }
+
+    template <typename Function>
+    double measure_ms(Function function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    std::string path = argc > 2 ? argv[2] : "radix_tree_frozen_bench.rdx";
+    auto keys = make_keys(count);
+
+    using tree_type = radix_tree<std::string, int>;
+    using frozen_type = frozen_radix_tree<std::string, int>;
+    tree_type radix_tree;
+    double build_ms = measure_ms([&] {
+        for (std::size_t i = 0; i < count; ++i) {
+            radix_tree.insert({keys[i], static_cast<int>(i)});
+        }
+    });
+
+    double write_ms = measure_ms([&] {
+        std::ofstream out(path, std::ios::binary);
+        frozen_type::write(radix_tree, out);
+    });
+
+    long found_sum = 0;
+    std::size_t image_size = 0;
+    double open_ms = measure_ms([&] {
+        radix_tree_mapped_file file(path);
+        frozen_type frozen(file.data(), file.size());
+        image_size = file.size();
+        found_sum = frozen.find(keys[count / 2])->second;
+    });
+
+    radix_tree_mapped_file file(path);
+    frozen_type frozen(file.data(), file.size());
+    long tree_sum = 0;
+    double tree_find_ms = measure_ms([&] {
+        for (auto& key : keys) {
+            tree_sum += radix_tree.find(key).value();
+        }
+    });
+    long frozen_sum = 0;
+    double frozen_find_ms = measure_ms([&] {
+        for (auto& key : keys) {
+            frozen_sum += frozen.find(key)->second;
+        }
+    });
+    std::remove(path.c_str());
+
+    std::cout << "keys: " << count << ", image: " << image_size / (1024.0 * 1024.0) << " MiB" << std::endl;
+    std::cout << "build with insert: " << build_ms << " ms" << std::endl;
+    std::cout << "write image:       " << write_ms << " ms" << std::endl;
+    std::cout << "map image + find:  " << open_ms << " ms" << std::endl;
+    std::cout << "find all, tree:    " << tree_find_ms << " ms" << std::endl;
+    std::cout << "find all, frozen:  " << frozen_find_ms << " ms" << std::endl;
+    return found_sum == static_cast<long>(count / 2) && tree_sum == frozen_sum ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// find_fuzzy against a brute force Levenshtein scan of every key
+#include "radix_tree.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    std::vector<std::string> make_words(const std::size_t count, std::mt19937_64& rng) {
+        // pronounceable words from common syllables, so that words share prefixes like a dictionary
+        const char* syllables[] = {"an", "ba", "con", "de", "er", "fi", "ge", "in", "ka", "lo", "ma", "ne", "or", "pre",
+                                   "qu", "re", "sta", "ti", "un", "ve", "wa", "xi", "yo", "ze", "ing", "tion", "ly", "ed"};
+        std::vector<std::string> words;
+        for (std::size_t i = 0; i < count; ++i) {
+            std::string word;
+            for (std::size_t n = 2 + rng() % 3; n > 0; --n) {
+                word += syllables[rng() % 28];
+            }
+            words.push_back(word);
+        }
+        return words;
+    }
+
+    std::size_t levenshtein(const std::string& lhs, const std::string& rhs) {
+        std::vector<std::size_t> above(rhs.size() + 1);
+        std::vector<std::size_t> row(rhs.size() + 1);
+        for (std::size_t j = 0; j <= rhs.size(); ++j) {
+            above[j] = j;
+        }
+        for (std::size_t i = 1; i <= lhs.size(); ++i) {
+            row[0] = i;
+            for (std::size_t j = 1; j <= rhs.size(); ++j) {
+                row[j] = std::min(std::min(above[j], row[j - 1]) + 1, above[j - 1] + (lhs[i - 1] == rhs[j - 1] ? 0 : 1));
+            }
+            std::swap(above, row);
+        }
+        return above[rhs.size()];
+    }
+
+    template <typename Function>
+    double measure_ms(Function function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    std::size_t query_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+    std::size_t max_distance = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 2;
+
+    std::mt19937_64 rng{42};
+    auto words = make_words(count, rng);
+    using tree_type = radix_tree<std::string, int>;
+    tree_type radix_tree;
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        radix_tree.insert({words[i], static_cast<int>(i)});
+    }
+
+    // misspelled words: one unit replaced
+    std::vector<std::string> queries;
+    for (std::size_t i = 0; i < query_count; ++i) {
+        std::string query = words[rng() % words.size()];
+        query[rng() % query.size()] = static_cast<char>('a' + rng() % 26);
+        queries.push_back(query);
+    }
+
+    std::size_t scan_found = 0;
+    double scan_ms = measure_ms([&] {
+        for (auto& query : queries) {
+            for (auto it = radix_tree.begin(); it != radix_tree.end(); ++it) {
+                scan_found += levenshtein(it.key(), query) <= max_distance;
+            }
+        }
+    });
+
+    std::size_t tree_found = 0;
+    double tree_ms = measure_ms([&] {
+        for (auto& query : queries) {
+            tree_found += radix_tree.find_fuzzy(query, max_distance).size();
+        }
+    });
+
+    std::cout << "keys: " << radix_tree.size() << ", queries: " << query_count << ", max distance: " << max_distance << std::endl;
+    std::cout << "scan:       " << scan_ms / query_count << " ms/query (" << scan_found << " matches)" << std::endl;
+    std::cout << "find_fuzzy: " << tree_ms / query_count << " ms/query (" << tree_found << " matches)" << std::endl;
+    return scan_found == tree_found ? 0 : 1;
+}
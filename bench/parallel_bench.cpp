@@ -0,0 +1,76 @@
+// Parallel bulk build and parallel visitation against their single threaded counterparts
+#include "radix_tree_parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    std::vector<std::pair<std::string, int>> make_sorted_keys(const std::size_t count) {
+        // url like keys sharing long prefixes
+        std::mt19937_64 rng{42};
+        const char* hosts[] = {"https://example.com/", "https://example.org/api/v1/", "https://cdn.example.net/static/"};
+        std::vector<std::pair<std::string, int>> keys;
+        keys.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            keys.emplace_back(std::string(hosts[rng() % 3]) + "users/" + std::to_string(rng() % 100000) + "/items/" + std::to_string(i), static_cast<int>(i));
+        }
+        std::sort(keys.begin(), keys.end());
+        return keys;
+    }
+
+    template <typename Function>
+    double measure_ms(Function function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    std::size_t max_threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    auto keys = make_sorted_keys(count);
+
+    using tree_type = radix_tree<std::string, int>;
+    tree_type radix_tree;
+    double assign_ms = measure_ms([&] {
+        radix_tree.assign(keys.begin(), keys.end());
+    });
+    long expected_sum = 0;
+    double iterate_ms = measure_ms([&] {
+        for (auto it = radix_tree.begin(); it != radix_tree.end(); ++it) {
+            expected_sum += it.value();
+        }
+    });
+
+    std::cout << "keys: " << count << std::endl;
+    std::cout << "assign, 1 thread:  " << assign_ms << " ms" << std::endl;
+    std::cout << "iterate, 1 thread: " << iterate_ms << " ms" << std::endl;
+
+    bool same = true;
+    for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+        tree_type parallel_tree;
+        double build_ms = measure_ms([&] {
+            parallel_assign(parallel_tree, keys.begin(), keys.end(), threads);
+        });
+
+        std::atomic<long> sum{0};
+        double visit_ms = measure_ms([&] {
+            parallel_for_each(parallel_tree, [&sum](std::string_view, int& value) {
+                sum.fetch_add(value, std::memory_order_relaxed);
+            }, threads);
+        });
+
+        same = same && parallel_tree.size() == radix_tree.size() && sum.load() == expected_sum;
+        std::cout << threads << " threads: parallel_assign " << build_ms << " ms, parallel_for_each " << visit_ms << " ms" << std::endl;
+    }
+    return same ? 0 : 1;
+}
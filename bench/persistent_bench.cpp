@@ -0,0 +1,86 @@
+// Snapshots of persistent_radix_tree against deep copies of radix_tree, and the cost of path copying
+#include "persistent_radix_tree.h"
+#include "radix_tree.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    template <typename Function>
+    double measure_ms(Function function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500000;
+    const std::size_t updates = 100000;
+
+    std::mt19937_64 rng{42};
+    const char* hosts[] = {"config/example.com/", "config/example.org/api/v1/", "config/cdn.example.net/static/"};
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        keys.push_back(std::string(hosts[rng() % 3]) + "users/" + std::to_string(rng() % 100000) + "/items/" + std::to_string(i));
+    }
+
+    radix_tree<std::string, int> tree;
+    double tree_insert_ms = measure_ms([&] {
+        for (std::size_t i = 0; i < count; ++i) {
+            tree.insert({keys[i], static_cast<int>(i)});
+        }
+    });
+
+    persistent_radix_tree<std::string, int> persistent;
+    double persistent_insert_ms = measure_ms([&] {
+        for (std::size_t i = 0; i < count; ++i) {
+            persistent.insert({keys[i], static_cast<int>(i)});
+        }
+    });
+
+    // what a consistent view costs: a copy of the whole tree, or one reference
+    std::size_t copied = 0;
+    double copy_ms = measure_ms([&] {
+        radix_tree<std::string, int> copy;
+        auto hint = copy.end();
+        for (auto it = tree.begin(); it != tree.end(); ++it) {
+            hint = copy.insert(hint, {it.key(), it->second});
+        }
+        copied = copy.size();
+    });
+
+    std::size_t snapshotted = 0;
+    double snapshot_ms = measure_ms([&] {
+        for (std::size_t i = 0; i < 1000; ++i) {
+            snapshotted += persistent.snapshot().size();
+        }
+    }) / 1000;
+
+    std::cout << "keys: " << count << std::endl;
+    std::cout << "insert radix_tree:            " << tree_insert_ms << " ms" << std::endl;
+    std::cout << "insert persistent_radix_tree: " << persistent_insert_ms << " ms" << std::endl;
+    std::cout << "deep copy of radix_tree:      " << copy_ms << " ms" << std::endl;
+    std::cout << "snapshot():                   " << snapshot_ms * 1000 << " us" << std::endl;
+
+    // updates copy the path of their key only while a snapshot holds the nodes on it
+    for (std::size_t every : {std::size_t{0}, std::size_t{100}, std::size_t{1}}) {
+        persistent_radix_tree<std::string, int>::snapshot_type version;
+        double update_ms = measure_ms([&] {
+            for (std::size_t i = 0; i < updates; ++i) {
+                if (every != 0 && i % every == 0) {
+                    version = persistent.snapshot();
+                }
+                persistent.insert_or_assign(keys[rng() % count], static_cast<int>(i));
+            }
+        });
+        std::cout << "updates, snapshot every " << every << ": " << update_ms * 1000 / updates << " us/update" << std::endl;
+    }
+    return copied == count && snapshotted == 1000 * count ? 0 : 1;
+}
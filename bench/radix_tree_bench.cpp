@@ -0,0 +1,393 @@
+// radix_tree against std::map, std::unordered_map and a sorted vector on generated datasets
+#include "radix_tree.h"
+#include "radix_tree_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+using namespace phamphilong;
+
+/**
+ * Memory footprint: every allocation of the process goes through these, live_bytes is what the heap really hands
+ * out (usable size, so allocator rounding counts too).
+ */
+namespace {
+    std::size_t live_bytes = 0;
+    std::size_t sink = 0;
+}
+
+#if defined(__GLIBC__)
+namespace {
+    void* allocate_counted(void* block) {
+        if (block == nullptr) {
+            throw std::bad_alloc();
+        }
+        live_bytes += malloc_usable_size(block);
+        return block;
+    }
+}
+
+void* operator new(std::size_t size) {
+    return allocate_counted(std::malloc(size == 0 ? 1 : size));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    std::size_t align = static_cast<std::size_t>(alignment);
+    return allocate_counted(std::aligned_alloc(align, (size + align - 1) / align * align));
+}
+
+void operator delete(void* block) noexcept {
+    if (block != nullptr) {
+        live_bytes -= malloc_usable_size(block);
+        std::free(block);
+    }
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete(void* block, std::align_val_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete(void* block, std::size_t, std::align_val_t) noexcept {
+    operator delete(block);
+}
+#endif
+
+namespace {
+    using dataset = std::vector<std::string>;
+
+    dataset make_urls(const std::size_t count, std::mt19937_64& rng) {
+        const char* hosts[] = {"https://example.com/", "https://example.org/api/v1/", "https://cdn.example.net/static/",
+                               "http://shop.example.com/catalog/"};
+        const char* sections[] = {"users/", "items/", "orders/", "images/", "search?q="};
+        dataset keys;
+        for (std::size_t i = 0; i < count; ++i) {
+            keys.push_back(std::string(hosts[rng() % 4]) + sections[rng() % 5] + std::to_string(rng() % 100000) + "/" + std::to_string(i));
+        }
+        return keys;
+    }
+
+    dataset make_words(const std::size_t count, std::mt19937_64& rng) {
+        // pronounceable words from common syllables, so that words share prefixes like a dictionary
+        const char* syllables[] = {"an", "ba", "con", "de", "er", "fi", "ge", "in", "ka", "lo", "ma", "ne", "or", "pre",
+                                   "qu", "re", "sta", "ti", "un", "ve", "wa", "xi", "yo", "ze", "ing", "tion", "ly", "ed"};
+        dataset keys;
+        for (std::size_t i = 0; i < count; ++i) {
+            std::string word;
+            for (std::size_t n = 2 + rng() % 4; n > 0; --n) {
+                word += syllables[rng() % 28];
+            }
+            keys.push_back(word + std::to_string(i % 97));
+        }
+        return keys;
+    }
+
+    dataset make_ipv4(const std::size_t count, std::mt19937_64& rng) {
+        // addresses clustered in a few networks
+        dataset keys;
+        for (std::size_t i = 0; i < count; ++i) {
+            unsigned network = static_cast<unsigned>(rng() % 16);
+            keys.push_back(std::to_string(10 + network) + "." + std::to_string(rng() % 256) + "." + std::to_string(rng() % 256) + "." + std::to_string(rng() % 256));
+        }
+        return keys;
+    }
+
+    dataset make_random_ids(const std::size_t count, std::mt19937_64& rng) {
+        dataset keys;
+        char id[17];
+        for (std::size_t i = 0; i < count; ++i) {
+            std::snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(rng()));
+            keys.push_back(id);
+        }
+        return keys;
+    }
+
+    dataset make_sequential_ids(const std::size_t count, std::mt19937_64&) {
+        dataset keys;
+        char id[24];
+        for (std::size_t i = 0; i < count; ++i) {
+            std::snprintf(id, sizeof(id), "id%012zu", i);
+            keys.push_back(id);
+        }
+        return keys;
+    }
+
+    void remove_duplicates(dataset& keys, std::mt19937_64& rng) {
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        std::shuffle(keys.begin(), keys.end(), rng);
+    }
+
+    /**
+     * Adapters give every container the same interface. prefix_count counts up to `limit` keys starting with prefix,
+     * like an autocomplete query; it returns false when the container cannot answer it without a full scan.
+     */
+    template <typename Allocator>
+    struct radix_tree_adapter {
+        radix_tree<std::string, int, split<std::string>, radix_len<std::string>, Allocator> container;
+
+        void insert(const std::string& key, const int value) {
+            container.insert({key, value});
+        }
+
+        bool find(const std::string& key) const {
+            return container.find(key) != container.end();
+        }
+
+        std::size_t erase(const std::string& key) {
+            return container.erase(key);
+        }
+
+        std::size_t iterate() const {
+            std::size_t total = 0;
+            for (auto entry : container) {
+                total += entry.first.size() + entry.second;
+            }
+            return total;
+        }
+
+        bool prefix_count(const std::string& prefix, const std::size_t limit, std::size_t& count) const {
+            for (auto entry : container.find_with_prefix(prefix, limit)) {
+                count += entry.first.size();
+            }
+            return true;
+        }
+    };
+
+    template <typename Map>
+    struct ordered_map_adapter {
+        Map container;
+
+        void insert(const std::string& key, const int value) {
+            container.insert({key, value});
+        }
+
+        bool find(const std::string& key) const {
+            return container.find(key) != container.end();
+        }
+
+        std::size_t erase(const std::string& key) {
+            return container.erase(key);
+        }
+
+        std::size_t iterate() const {
+            std::size_t total = 0;
+            for (auto& entry : container) {
+                total += entry.first.size() + entry.second;
+            }
+            return total;
+        }
+
+        bool prefix_count(const std::string& prefix, const std::size_t limit, std::size_t& count) const {
+            std::size_t found = 0;
+            for (auto it = container.lower_bound(prefix); found < limit && it != container.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it, ++found) {
+                count += it->first.size();
+            }
+            return true;
+        }
+    };
+
+    struct unordered_map_adapter {
+        std::unordered_map<std::string, int> container;
+
+        void insert(const std::string& key, const int value) {
+            container.insert({key, value});
+        }
+
+        bool find(const std::string& key) const {
+            return container.find(key) != container.end();
+        }
+
+        std::size_t erase(const std::string& key) {
+            return container.erase(key);
+        }
+
+        std::size_t iterate() const {
+            std::size_t total = 0;
+            for (auto& entry : container) {
+                total += entry.first.size() + entry.second;
+            }
+            return total;
+        }
+
+        bool prefix_count(const std::string&, const std::size_t, std::size_t&) const {
+            return false;
+        }
+    };
+
+    struct sorted_vector_adapter {
+        // filled then sorted once, like a static dictionary; erasing from the middle is O(n) so it is not measured
+        std::vector<std::pair<std::string, int>> container;
+        bool sorted{false};
+
+        void insert(const std::string& key, const int value) {
+            container.emplace_back(key, value);
+        }
+
+        void finish_insert() {
+            std::sort(container.begin(), container.end());
+            sorted = true;
+        }
+
+        std::vector<std::pair<std::string, int>>::const_iterator lower_bound(const std::string& key) const {
+            return std::lower_bound(container.begin(), container.end(), key, [](const std::pair<std::string, int>& entry, const std::string& k) {
+                return entry.first < k;
+            });
+        }
+
+        bool find(const std::string& key) const {
+            auto it = lower_bound(key);
+            return it != container.end() && it->first == key;
+        }
+
+        std::size_t iterate() const {
+            std::size_t total = 0;
+            for (auto& entry : container) {
+                total += entry.first.size() + entry.second;
+            }
+            return total;
+        }
+
+        bool prefix_count(const std::string& prefix, const std::size_t limit, std::size_t& count) const {
+            std::size_t found = 0;
+            for (auto it = lower_bound(prefix); found < limit && it != container.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it, ++found) {
+                count += it->first.size();
+            }
+            return true;
+        }
+    };
+
+    template <typename Function>
+    double measure_ns(Function function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const std::string& dataset_name, const std::string& container_name, const std::string& operation,
+                const double elapsed_ns, const std::size_t operations) {
+        double ns_per_op = elapsed_ns / operations;
+        std::cout << std::left << std::setw(12) << dataset_name << std::setw(20) << container_name << std::setw(12) << operation
+                  << std::right << std::fixed << std::setprecision(1) << std::setw(12) << ns_per_op << " ns/op"
+                  << std::setw(14) << std::setprecision(0) << 1e9 / ns_per_op << " ops/s" << std::endl;
+    }
+
+    template <typename Adapter>
+    void run(const std::string& dataset_name, const std::string& container_name, const dataset& keys,
+             const dataset& missing_keys, const dataset& prefixes) {
+        std::size_t bytes_before = live_bytes;
+        auto adapter = std::make_unique<Adapter>();
+        std::size_t count = keys.size();
+
+        report(dataset_name, container_name, "insert", measure_ns([&] {
+            for (std::size_t i = 0; i < count; ++i) {
+                adapter->insert(keys[i], static_cast<int>(i));
+            }
+            if constexpr (std::is_same<Adapter, sorted_vector_adapter>::value) {
+                adapter->finish_insert();
+            }
+        }), count);
+
+#if defined(__GLIBC__)
+        std::size_t bytes = live_bytes - bytes_before;
+        std::cout << std::left << std::setw(12) << dataset_name << std::setw(20) << container_name << std::setw(12) << "memory"
+                  << std::right << std::fixed << std::setprecision(1) << std::setw(12) << static_cast<double>(bytes) / count << " bytes/key" << std::endl;
+#else
+        (void) bytes_before;
+#endif
+
+        report(dataset_name, container_name, "find-hit", measure_ns([&] {
+            for (auto& key : keys) {
+                sink += adapter->find(key);
+            }
+        }), count);
+
+        report(dataset_name, container_name, "find-miss", measure_ns([&] {
+            for (auto& key : missing_keys) {
+                sink += adapter->find(key);
+            }
+        }), missing_keys.size());
+
+        report(dataset_name, container_name, "iterate", measure_ns([&] {
+            sink += adapter->iterate();
+        }), count);
+
+        std::size_t matched = 0;
+        bool answered = true;
+        double prefix_ns = measure_ns([&] {
+            for (auto& prefix : prefixes) {
+                answered = adapter->prefix_count(prefix, 10, matched) && answered;
+            }
+        });
+        if (answered) {
+            report(dataset_name, container_name, "prefix(10)", prefix_ns, prefixes.size());
+        }
+        sink += matched;
+
+        if constexpr (!std::is_same<Adapter, sorted_vector_adapter>::value) {
+            report(dataset_name, container_name, "erase", measure_ns([&] {
+                for (auto& key : keys) {
+                    sink += adapter->erase(key);
+                }
+            }), count);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    std::string only_dataset = argc > 2 ? argv[2] : "";
+
+    using generator = dataset (*)(std::size_t, std::mt19937_64&);
+    std::pair<const char*, generator> datasets[] = {
+            {"urls", make_urls}, {"words", make_words}, {"ipv4", make_ipv4},
+            {"random-id", make_random_ids}, {"seq-id", make_sequential_ids}};
+
+    std::cout << "keys per dataset: " << count << " (usage: radix_tree_bench [count] [dataset])" << std::endl;
+    for (auto& entry : datasets) {
+        if (!only_dataset.empty() && only_dataset != entry.first) {
+            continue;
+        }
+
+        std::mt19937_64 rng{42};
+        dataset keys = entry.second(count, rng);
+        remove_duplicates(keys, rng);
+
+        // misses share prefixes with the keys, prefixes are the first half of random keys
+        dataset missing_keys;
+        dataset prefixes;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            missing_keys.push_back(keys[i] + "#");
+            if (i % 16 == 0) {
+                prefixes.push_back(keys[i].substr(0, keys[i].size() / 2));
+            }
+        }
+
+        using pool_allocator = radix_tree_pool_allocator<std::pair<const std::string, int>>;
+        run<radix_tree_adapter<std::allocator<std::pair<const std::string, int>>>>(entry.first, "radix_tree", keys, missing_keys, prefixes);
+        run<radix_tree_adapter<pool_allocator>>(entry.first, "radix_tree+pool", keys, missing_keys, prefixes);
+        run<ordered_map_adapter<std::map<std::string, int>>>(entry.first, "std::map", keys, missing_keys, prefixes);
+        run<unordered_map_adapter>(entry.first, "std::unordered_map", keys, missing_keys, prefixes);
+        run<sorted_vector_adapter>(entry.first, "sorted vector", keys, missing_keys, prefixes);
+        std::cout << std::endl;
+    }
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+// count_with_prefix, rank and select with subtree counts against counting with iterators
+#include "radix_tree.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+    struct item {
+        int index;
+    };
+}
+
+namespace phamphilong {
+    template <>
+    struct radix_subtree_count<item> : std::true_type {};
+}
+
+using namespace phamphilong;
+
+namespace {
+    template <typename Function>
+    double measure_ms(Function function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const std::size_t queries = 1000;
+
+    std::mt19937_64 rng{42};
+    const char* hosts[] = {"https://example.com/", "https://example.org/api/v1/", "https://cdn.example.net/static/"};
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    radix_tree<std::string, item> tree;
+    for (std::size_t i = 0; i < count; ++i) {
+        keys.push_back(std::string(hosts[rng() % 3]) + "users/" + std::to_string(rng() % 100000) + "/items/" + std::to_string(i));
+        tree.insert({keys.back(), item{static_cast<int>(i)}});
+    }
+
+    // short prefixes, i.e. large subtrees
+    std::vector<std::string> prefixes;
+    for (std::size_t i = 0; i < queries; ++i) {
+        prefixes.push_back(keys[rng() % count].substr(0, 27));
+    }
+
+    std::size_t counted = 0;
+    double count_ms = measure_ms([&] {
+        for (auto& prefix : prefixes) {
+            counted += tree.count_with_prefix(prefix);
+        }
+    });
+
+    std::size_t iterated = 0;
+    double iterate_ms = measure_ms([&] {
+        for (auto& prefix : prefixes) {
+            auto range = tree.find_with_prefix(prefix);
+            iterated += static_cast<std::size_t>(std::distance(range.begin(), range.end()));
+        }
+    });
+
+    std::size_t ranked = 0;
+    double rank_ms = measure_ms([&] {
+        for (std::size_t i = 0; i < queries; ++i) {
+            ranked += tree.rank(keys[rng() % count]);
+        }
+    });
+
+    std::size_t selected = 0;
+    double select_ms = measure_ms([&] {
+        for (std::size_t i = 0; i < queries; ++i) {
+            selected += tree.select(rng() % count)->second.index & 1;
+        }
+    });
+
+    std::cout << "keys: " << count << ", queries: " << queries << std::endl;
+    std::cout << "count_with_prefix: " << count_ms / queries * 1000 << " us/query" << std::endl;
+    std::cout << "iterate prefix:    " << iterate_ms / queries * 1000 << " us/query" << std::endl;
+    std::cout << "rank:              " << rank_ms / queries * 1000 << " us/query" << std::endl;
+    std::cout << "select:            " << select_ms / queries * 1000 << " us/query" << std::endl;
+    std::cout << "(" << ranked % 2 + selected % 2 << ")" << std::endl;
+    return counted == iterated ? 0 : 1;
+}
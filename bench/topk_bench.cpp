@@ -0,0 +1,102 @@
+// top_k_with_prefix on scored values against scanning the prefix range and sorting it
+#include "radix_tree.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    struct completion {
+        std::uint32_t popularity;
+    };
+}
+
+namespace phamphilong {
+    template <>
+    struct radix_score<completion> {
+        using score_type = std::uint32_t;
+
+        static score_type get(const completion& value) {
+            return value.popularity;
+        }
+    };
+}
+
+using namespace phamphilong;
+
+namespace {
+    std::string make_word(std::mt19937_64& rng) {
+        // pronounceable words, so that short prefixes have large subtrees
+        static const char* syllables[] = {"ka", "to", "ri", "ne", "sa", "mo", "lu", "pe", "di", "ga", "vo", "shi", "tan", "ber"};
+        std::string word;
+        for (std::size_t count = 2 + rng() % 4; count > 0; --count) {
+            word += syllables[rng() % (sizeof(syllables) / sizeof(syllables[0]))];
+        }
+        return word;
+    }
+
+    template <typename Function>
+    double measure_ms(Function function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const std::size_t k = 10;
+    const std::size_t queries = 200;
+
+    // zipf like popularity: a few very popular words, a long tail
+    std::mt19937_64 rng{42};
+    radix_tree<std::string, completion> tree;
+    std::vector<std::string> words;
+    for (std::size_t i = 0; i < count; ++i) {
+        words.push_back(make_word(rng));
+        auto popularity = static_cast<std::uint32_t>(1000000.0 / static_cast<double>(1 + rng() % count));
+        tree.insert({words.back(), completion{popularity}});
+    }
+
+    std::vector<std::string> prefixes;
+    for (std::size_t i = 0; i < queries; ++i) {
+        const std::string& word = words[rng() % words.size()];
+        prefixes.push_back(word.substr(0, 1 + rng() % 3));
+    }
+
+    std::uint64_t top_k_sum = 0;
+    double top_k_ms = measure_ms([&] {
+        for (auto& prefix : prefixes) {
+            for (auto& it : tree.top_k_with_prefix(prefix, k)) {
+                top_k_sum += it->second.popularity;
+            }
+        }
+    });
+
+    std::uint64_t scan_sum = 0;
+    double scan_ms = measure_ms([&] {
+        std::vector<std::uint32_t> scores;
+        for (auto& prefix : prefixes) {
+            scores.clear();
+            for (auto entry : tree.find_with_prefix(prefix)) {
+                scores.push_back(entry.second.popularity);
+            }
+            std::size_t top = std::min(k, scores.size());
+            std::partial_sort(scores.begin(), scores.begin() + static_cast<std::ptrdiff_t>(top), scores.end(), std::greater<std::uint32_t>());
+            for (std::size_t i = 0; i < top; ++i) {
+                scan_sum += scores[i];
+            }
+        }
+    });
+
+    std::cout << "keys: " << tree.size() << ", k: " << k << ", queries: " << queries << std::endl;
+    std::cout << "top_k_with_prefix: " << top_k_ms / queries << " ms/query" << std::endl;
+    std::cout << "scan and sort:     " << scan_ms / queries << " ms/query" << std::endl;
+    std::cout << "speedup:           " << scan_ms / top_k_ms << "x" << std::endl;
+    return top_k_sum == scan_sum ? 0 : 1;
+}
@@ -0,0 +1,825 @@
+//
+// Radix tree safe for concurrent readers and writers.
+//
+
+#ifndef PHAM_PHI_LONG_CONCURRENT_RADIX_TREE_H
+#define PHAM_PHI_LONG_CONCURRENT_RADIX_TREE_H
+
+#include "radix_tree_epoch.h"
+#include "radix_tree_node.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace phamphilong {
+    /**
+     * Read:
+     *      https://db.in.tum.de/~leis/papers/artsync.pdf
+     * for optimistic lock coupling.
+     *
+     * Same keys, customization points and find / insert / erase as radix_tree, but every operation may run
+     * concurrently with any other one:
+     *      - every node has a version word, bit 1 is its write lock, bit 0 marks a node unlinked from the tree
+     *      - readers never write shared memory: they read a node, then check its version did not change meanwhile,
+     *        and restart from the root when it did
+     *      - a writer locks only the nodes it changes, by moving the version it read to locked: the node it adds a
+     *        child or a value to, the parent and the child on a split, the nodes merged away by erase
+     *      - labels and children tables are never modified once a node or table is reachable, a writer publishes a
+     *        new table or a new node and retires the old one to radix_tree_epoch
+     *
+     *                 ROOT                                ROOT
+     *                  |          insert("abd")            |
+     *                 abc        ==============>           ab   (new)
+     *                / \                                 /  \
+     *               x   y                       (new)   c    d  (new)
+     *                                                  / \
+     *                                                 x   y
+     *
+     * Above, ROOT and "abc" are locked; ROOT gets a new children table, "abc" is unlinked and replaced by "c" which
+     * takes over its table and value. Readers already inside "abc" see a consistent old version of it or restart.
+     *
+     * There are no iterators: a node may be unlinked right after a reader leaves it, so find returns a copy of the
+     * value. Nodes are allocated with new, they may outlive the tree in the retire lists.
+     */
+    template <typename Key, typename T, typename Split = split<Key>, typename Len = radix_len<Key>>
+    class concurrent_radix_tree {
+    public:
+        using mapped_type = T;
+        using key_type = Key;
+        using value_type = std::pair<const key_type , mapped_type>;
+        using size_type = std::size_t;
+        using key_view_type = typename Split::view_type;
+        using unit_type = unsigned char;
+        static_assert(sizeof(typename key_view_type::value_type) == 1, "children are indexed by one byte units, keys of wider units would share slots");
+
+        concurrent_radix_tree() : root_node{create_node(key_view_type{})} {}
+        concurrent_radix_tree(const concurrent_radix_tree&) = delete;
+        concurrent_radix_tree& operator= (const concurrent_radix_tree&) = delete;
+        ~concurrent_radix_tree() {
+            // no operation may run concurrently with the destructor
+            destroy_subtree(root_node);
+        }
+
+        std::optional<mapped_type> find(key_view_type key) const;
+        bool insert(const value_type& value);
+        size_type erase(key_view_type key);
+
+        size_type size() const noexcept {
+            return tree_size.load(std::memory_order_relaxed);
+        }
+
+    private:
+        using char_type = typename key_view_type::value_type;
+        using deleter_type = radix_tree_epoch::deleter_type;
+
+        static constexpr std::uint64_t obsolete_bit = 1;
+        static constexpr std::uint64_t locked_bit = 2;
+        static constexpr size_type spin_attempts = 64;
+
+        struct child_table;
+
+        struct node {
+            std::atomic<std::uint64_t> version{0};
+            std::atomic<child_table*> children{nullptr};
+            std::atomic<mapped_type*> value{nullptr};   // only set if a key ends at this node
+            std::uint32_t label_len{0};                 // label_len units follow the node
+
+            const char_type* label_data() const {
+                return reinterpret_cast<const char_type*>(this + 1);
+            }
+
+            key_view_type get_search_key() const {
+                return key_view_type(label_data(), label_len);
+            }
+
+            unit_type get_search_unit() const {
+                return static_cast<unit_type>(label_data()[0]);
+            }
+        };
+
+        /**
+         * Immutable children table, indexed by the first unit of each label. Up to max_sorted_count children are kept
+         * as sorted units followed by the child pointers, more take a direct table of 256 pointers.
+         */
+        struct alignas(alignof(node*)) child_table {
+            static constexpr size_type max_sorted_count = 32;
+
+            std::uint16_t count;
+            bool direct;
+
+            static child_table* allocate(const size_type count, const bool direct);
+            static child_table* with_child(const child_table* table, const unit_type unit, node* child);
+            static child_table* without_child(const child_table* table, const unit_type unit);
+
+            static child_table* make_pair(const unit_type lhs_unit, node* lhs, const unit_type rhs_unit, node* rhs) {
+                // table of two children with different units
+                child_table* table = allocate(2, false);
+                bool lhs_first = lhs_unit < rhs_unit;
+                table->units()[0] = lhs_first ? lhs_unit : rhs_unit;
+                table->units()[1] = lhs_first ? rhs_unit : lhs_unit;
+                table->slots()[0] = lhs_first ? lhs : rhs;
+                table->slots()[1] = lhs_first ? rhs : lhs;
+                return table;
+            }
+
+            static size_type units_size(const size_type count) noexcept {
+                // keep the pointers aligned
+                return (count + alignof(node*) - 1) / alignof(node*) * alignof(node*);
+            }
+
+            unit_type* units() noexcept {
+                return reinterpret_cast<unit_type*>(this + 1);
+            }
+
+            const unit_type* units() const noexcept {
+                return reinterpret_cast<const unit_type*>(this + 1);
+            }
+
+            node** slots() noexcept {
+                return reinterpret_cast<node**>(reinterpret_cast<char*>(this + 1) + (direct ? 0 : units_size(count)));
+            }
+
+            node* const* slots() const noexcept {
+                return const_cast<child_table*>(this)->slots();
+            }
+
+            node* find(const unit_type unit) const noexcept {
+                if (direct) {
+                    return slots()[unit];
+                }
+
+                const unit_type* table_units = units();
+                for (size_type i = 0; i < count && table_units[i] <= unit; ++i) {
+                    if (table_units[i] == unit) {
+                        return slots()[i];
+                    }
+                }
+                return nullptr;
+            }
+
+            node* first_from(const size_type unit) const noexcept {
+                // first child whose unit is not below `unit`, nullptr if there is none
+                if (direct) {
+                    for (size_type i = unit; i < 256; ++i) {
+                        if (slots()[i] != nullptr) {
+                            return slots()[i];
+                        }
+                    }
+                    return nullptr;
+                }
+
+                const unit_type* table_units = units();
+                for (size_type i = 0; i < count; ++i) {
+                    if (table_units[i] >= unit) {
+                        return slots()[i];
+                    }
+                }
+                return nullptr;
+            }
+
+            template <typename Visitor>
+            void for_each(Visitor visitor) const {
+                // visit children in unit order
+                if (direct) {
+                    for (size_type unit = 0; unit < 256; ++unit) {
+                        if (slots()[unit] != nullptr) {
+                            visitor(static_cast<unit_type>(unit), slots()[unit]);
+                        }
+                    }
+                } else {
+                    for (size_type i = 0; i < count; ++i) {
+                        visitor(units()[i], slots()[i]);
+                    }
+                }
+            }
+        };
+
+        /**
+         * Objects built before taking the locks of a write. They are freed when the attempt restarts, unless they
+         * were published into the tree.
+         */
+        class pending_objects {
+        public:
+            pending_objects() = default;
+            pending_objects(const pending_objects&) = delete;
+            pending_objects& operator= (const pending_objects&) = delete;
+            ~pending_objects() {
+                for (size_type i = 0; i < count; ++i) {
+                    deleters[i](objects[i]);
+                }
+            }
+
+            template <typename U>
+            U* add(U* object, deleter_type deleter) noexcept {
+                if (object != nullptr) {
+                    objects[count] = object;
+                    deleters[count] = deleter;
+                    ++count;
+                }
+                return object;
+            }
+
+            void publish() noexcept {
+                count = 0;
+            }
+
+        private:
+            void* objects[6]{};
+            deleter_type deleters[6]{};
+            size_type count{0};
+        };
+
+        node* const root_node;
+        std::atomic<size_type> tree_size{0};
+        const Split split_key{};
+        const Len get_key_len{};
+
+        static unit_type key_unit(key_view_type key, const size_type pos) {
+            return static_cast<unit_type>(key[pos]);
+        }
+
+        bool match_label(key_view_type key, const size_type cur_key_depth, const node* child_node) const {
+            // true if the edge label of child node is a prefix of key[cur_key_depth..]
+            key_view_type label = child_node->get_search_key();
+            size_type label_len = child_node->label_len;
+            return label_len <= get_key_len(key) - cur_key_depth && split_key(key, cur_key_depth, label_len) == label;
+        }
+
+        static bool read_lock(const node* version_node, std::uint64_t& version) noexcept {
+            // false if a writer holds node or has unlinked it
+            version = version_node->version.load(std::memory_order_acquire);
+            return (version & (locked_bit | obsolete_bit)) == 0;
+        }
+
+        static bool validate(const node* version_node, const std::uint64_t version) noexcept {
+            // true if node did not change since read_lock returned version
+            return version_node->version.load(std::memory_order_acquire) == version;
+        }
+
+        static bool upgrade_to_write_lock(node* version_node, std::uint64_t version) noexcept {
+            return version_node->version.compare_exchange_strong(version, version | locked_bit, std::memory_order_acquire);
+        }
+
+        static void write_unlock(node* version_node) noexcept {
+            version_node->version.fetch_add(locked_bit, std::memory_order_release);
+        }
+
+        static void write_unlock_obsolete(node* version_node) noexcept {
+            version_node->version.fetch_add(locked_bit | obsolete_bit, std::memory_order_release);
+        }
+
+        static void back_off(const size_type attempt) {
+            if (attempt >= spin_attempts) {
+                std::this_thread::yield();
+            }
+        }
+
+        bool try_find(key_view_type key, std::optional<mapped_type>& result) const;
+        bool try_insert(key_view_type key, const mapped_type& value, bool& inserted);
+        bool try_erase(key_view_type key, size_type& erased);
+
+        node* create_node(key_view_type prefix, key_view_type suffix = key_view_type{}) const {
+            // the label prefix + suffix is stored right after the node
+            size_type prefix_len = get_key_len(prefix);
+            size_type label_len = prefix_len + get_key_len(suffix);
+            void* memory = ::operator new(sizeof(node) + label_len * sizeof(char_type));
+            node* new_node = ::new (memory) node{};
+            auto label = reinterpret_cast<char_type*>(new_node + 1);
+            std::copy(prefix.data(), prefix.data() + prefix_len, label);
+            std::copy(suffix.data(), suffix.data() + (label_len - prefix_len), label + prefix_len);
+            new_node->label_len = static_cast<std::uint32_t>(label_len);
+            return new_node;
+        }
+
+        static void free_node(void* object) noexcept {
+            // a node owns neither its table nor its value, they are handed over to the node replacing it
+            static_cast<node*>(object)->~node();
+            ::operator delete(object);
+        }
+
+        static void free_table(void* object) noexcept {
+            ::operator delete(object);
+        }
+
+        static void free_value(void* object) noexcept {
+            delete static_cast<mapped_type*>(object);
+        }
+
+        static void retire(void* object, deleter_type deleter) {
+            if (object != nullptr) {
+                radix_tree_epoch::instance().retire(object, deleter);
+            }
+        }
+
+        static void destroy_subtree(node* subtree_node) noexcept {
+            /**
+             * Post-order without recursion, so that long chains of nodes do not overflow the stack. Nodes have no
+             * parent links, but nobody reads the version of a node being destroyed: it holds the parent to go back
+             * to, whose table gives the next sibling.
+             */
+            auto first_child = [](const node* parent_node) -> node* {
+                child_table* table = parent_node->children.load(std::memory_order_relaxed);
+                return table != nullptr ? table->first_from(0) : nullptr;
+            };
+            auto destroy_node = [](node* destroyed_node) {
+                free_table(destroyed_node->children.load(std::memory_order_relaxed));
+                free_value(destroyed_node->value.load(std::memory_order_relaxed));
+                free_node(destroyed_node);
+            };
+
+            node* current_node = subtree_node;
+            for (;;) {
+                for (node* child_node = first_child(current_node); child_node != nullptr; child_node = first_child(current_node)) {
+                    child_node->version.store(reinterpret_cast<std::uintptr_t>(current_node), std::memory_order_relaxed);
+                    current_node = child_node;
+                }
+
+                for (;;) {
+                    if (current_node == subtree_node) {
+                        destroy_node(current_node);
+                        return;
+                    }
+
+                    auto parent_node = reinterpret_cast<node*>(static_cast<std::uintptr_t>(current_node->version.load(std::memory_order_relaxed)));
+                    size_type unit = current_node->get_search_unit();
+                    destroy_node(current_node);
+                    current_node = parent_node->children.load(std::memory_order_relaxed)->first_from(unit + 1);
+                    if (current_node != nullptr) {
+                        current_node->version.store(reinterpret_cast<std::uintptr_t>(parent_node), std::memory_order_relaxed);
+                        break;
+                    }
+                    current_node = parent_node;
+                }
+            }
+        }
+    };
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename concurrent_radix_tree<Key, T, Split, Len>::child_table*
+    concurrent_radix_tree<Key, T, Split, Len>::child_table::allocate(const size_type count, const bool direct) {
+        size_type bytes = sizeof(child_table) + (direct ? 256 * sizeof(node*) : units_size(count) + count * sizeof(node*));
+        auto table = ::new (::operator new(bytes)) child_table{static_cast<std::uint16_t>(count), direct};
+        if (direct) {
+            std::fill_n(table->slots(), 256, nullptr);
+        }
+        return table;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename concurrent_radix_tree<Key, T, Split, Len>::child_table*
+    concurrent_radix_tree<Key, T, Split, Len>::child_table::with_child(const child_table* table, const unit_type unit, node* child) {
+        // copy of table where unit leads to child, added or replaced
+        size_type count = table == nullptr ? 0 : table->count;
+        size_type new_count = table != nullptr && table->find(unit) != nullptr ? count : count + 1;
+        bool direct = new_count > max_sorted_count;
+        child_table* new_table = allocate(new_count, direct);
+
+        size_type i = 0;
+        bool placed = false;
+        auto place = [&](const unit_type child_unit, node* child_node) {
+            if (direct) {
+                new_table->slots()[child_unit] = child_node;
+            } else {
+                new_table->units()[i] = child_unit;
+                new_table->slots()[i] = child_node;
+                ++i;
+            }
+        };
+        if (table != nullptr) {
+            table->for_each([&](const unit_type child_unit, node* child_node) {
+                if (!placed && child_unit >= unit) {
+                    place(unit, child);
+                    placed = true;
+                }
+                if (child_unit != unit) {
+                    place(child_unit, child_node);
+                }
+            });
+        }
+        if (!placed) {
+            place(unit, child);
+        }
+        return new_table;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename concurrent_radix_tree<Key, T, Split, Len>::child_table*
+    concurrent_radix_tree<Key, T, Split, Len>::child_table::without_child(const child_table* table, const unit_type unit) {
+        // copy of table without unit, nullptr when no child is left
+        size_type new_count = table->count - 1;
+        if (new_count == 0) {
+            return nullptr;
+        }
+
+        // shrink back to sorted units well below the growth threshold, so that a node does not flip between both
+        bool direct = table->direct && new_count > max_sorted_count / 2;
+        child_table* new_table = allocate(new_count, direct);
+        size_type i = 0;
+        table->for_each([&](const unit_type child_unit, node* child_node) {
+            if (child_unit == unit) {
+                return;
+            }
+            if (direct) {
+                new_table->slots()[child_unit] = child_node;
+            } else {
+                new_table->units()[i] = child_unit;
+                new_table->slots()[i] = child_node;
+                ++i;
+            }
+        });
+        return new_table;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    std::optional<typename concurrent_radix_tree<Key, T, Split, Len>::mapped_type>
+    concurrent_radix_tree<Key, T, Split, Len>::find(key_view_type key) const {
+        radix_tree_epoch::guard guard;
+        for (size_type attempt = 0; ; ++attempt) {
+            std::optional<mapped_type> result;
+            if (try_find(key, result)) {
+                return result;
+            }
+            back_off(attempt);
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    bool concurrent_radix_tree<Key, T, Split, Len>::try_find(key_view_type key, std::optional<mapped_type>& result) const {
+        /**
+         * Lock coupling without locks: the version of a child is read before checking that its parent did not change,
+         * so at that point the parent really led to the child. Labels never change and values are replaced, not
+         * modified, so reading them needs no check of its own.
+         */
+        size_type key_len = get_key_len(key);
+        node* traverse_node = root_node;
+        std::uint64_t version;
+        if (!read_lock(traverse_node, version)) {
+            return false;
+        }
+
+        for (size_type cur_key_depth = 0; ; ) {
+            if (cur_key_depth == key_len) {
+                mapped_type* value = traverse_node->value.load(std::memory_order_acquire);
+                if (value != nullptr) {
+                    result.emplace(*value);
+                }
+                return validate(traverse_node, version);
+            }
+
+            child_table* table = traverse_node->children.load(std::memory_order_acquire);
+            node* child_node = table == nullptr ? nullptr : table->find(key_unit(key, cur_key_depth));
+            if (child_node == nullptr) {
+                return validate(traverse_node, version);        // cannot find
+            }
+
+            std::uint64_t child_version;
+            if (!read_lock(child_node, child_version) || !validate(traverse_node, version)) {
+                return false;
+            }
+
+            if (!match_label(key, cur_key_depth, child_node)) {
+                return true;        // cannot find
+            }
+
+            cur_key_depth += child_node->label_len;
+            traverse_node = child_node;
+            version = child_version;
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    bool concurrent_radix_tree<Key, T, Split, Len>::insert(const value_type& value) {
+        radix_tree_epoch::guard guard;
+        key_view_type key = value.first;
+        bool inserted = false;
+        for (size_type attempt = 0; !try_insert(key, value.second, inserted); ++attempt) {
+            back_off(attempt);
+        }
+
+        if (inserted) {
+            tree_size.fetch_add(1, std::memory_order_relaxed);
+        }
+        return inserted;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    bool concurrent_radix_tree<Key, T, Split, Len>::try_insert(key_view_type key, const mapped_type& value, bool& inserted) {
+        /**
+         * Descend like find, then lock only what changes. Everything the write publishes is built before the locks
+         * are taken, locking a node fails if its version moved since it was read, and the attempt restarts.
+         */
+        size_type key_len = get_key_len(key);
+        node* parent_node = root_node;
+        std::uint64_t version;
+        if (!read_lock(parent_node, version)) {
+            return false;
+        }
+
+        for (size_type cur_key_depth = 0; ; ) {
+            pending_objects pending;
+            if (cur_key_depth == key_len) {
+                // the key ends at parent node
+                if (parent_node->value.load(std::memory_order_acquire) != nullptr) {
+                    inserted = false;
+                    return validate(parent_node, version);
+                }
+
+                mapped_type* new_value = pending.add(new mapped_type(value), free_value);
+                if (!upgrade_to_write_lock(parent_node, version)) {
+                    return false;
+                }
+                parent_node->value.store(new_value, std::memory_order_release);
+                write_unlock(parent_node);
+                pending.publish();
+                inserted = true;
+                return true;
+            }
+
+            unit_type unit = key_unit(key, cur_key_depth);
+            child_table* table = parent_node->children.load(std::memory_order_acquire);
+            node* child_node = table == nullptr ? nullptr : table->find(unit);
+            if (child_node == nullptr) {
+                // add a leaf under parent node
+                node* new_node = pending.add(create_node(split_key(key, cur_key_depth)), free_node);
+                new_node->value.store(pending.add(new mapped_type(value), free_value), std::memory_order_relaxed);
+                child_table* new_table = pending.add(child_table::with_child(table, unit, new_node), free_table);
+                if (!upgrade_to_write_lock(parent_node, version)) {
+                    return false;
+                }
+                parent_node->children.store(new_table, std::memory_order_release);
+                write_unlock(parent_node);
+                pending.publish();
+                retire(table, free_table);
+                inserted = true;
+                return true;
+            }
+
+            std::uint64_t child_version;
+            if (!read_lock(child_node, child_version) || !validate(parent_node, version)) {
+                return false;
+            }
+
+            key_view_type label = child_node->get_search_key();
+            size_type label_len = child_node->label_len;
+            size_type i = 0;
+            for (; i < label_len && cur_key_depth + i < key_len && key_unit(key, cur_key_depth + i) == key_unit(label, i); ++i) {}
+            if (i == label_len) {
+                // matched path
+                cur_key_depth += label_len;
+                parent_node = child_node;
+                version = child_version;
+                continue;
+            }
+
+            /**
+             * Split child node after i units: a new node with the common units replaces it, a copy with the rest of
+             * the label takes over its table and value
+             *
+             *       parent                   parent
+             *         |                        |
+             *       child        ====>      new parent
+             *                               /       \
+             *                          new child   new node (unless the key ends at new parent)
+             */
+            node* new_parent_node = pending.add(create_node(split_key(label, 0, i)), free_node);
+            node* new_child_node = pending.add(create_node(split_key(label, i)), free_node);
+            child_table* new_parent_table;
+            if (cur_key_depth + i == key_len) {
+                new_parent_node->value.store(pending.add(new mapped_type(value), free_value), std::memory_order_relaxed);
+                new_parent_table = child_table::with_child(nullptr, key_unit(label, i), new_child_node);
+            } else {
+                node* new_node = pending.add(create_node(split_key(key, cur_key_depth + i)), free_node);
+                new_node->value.store(pending.add(new mapped_type(value), free_value), std::memory_order_relaxed);
+                new_parent_table = child_table::make_pair(key_unit(label, i), new_child_node, key_unit(key, cur_key_depth + i), new_node);
+            }
+            new_parent_node->children.store(pending.add(new_parent_table, free_table), std::memory_order_relaxed);
+            child_table* new_table = pending.add(child_table::with_child(table, unit, new_parent_node), free_table);
+
+            if (!upgrade_to_write_lock(parent_node, version)) {
+                return false;
+            }
+            if (!upgrade_to_write_lock(child_node, child_version)) {
+                write_unlock(parent_node);
+                return false;
+            }
+            new_child_node->children.store(child_node->children.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            new_child_node->value.store(child_node->value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            parent_node->children.store(new_table, std::memory_order_release);
+            write_unlock_obsolete(child_node);
+            write_unlock(parent_node);
+            pending.publish();
+            retire(table, free_table);
+            retire(child_node, free_node);
+            inserted = true;
+            return true;
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename concurrent_radix_tree<Key, T, Split, Len>::size_type concurrent_radix_tree<Key, T, Split, Len>::erase(key_view_type key) {
+        radix_tree_epoch::guard guard;
+        size_type erased = 0;
+        for (size_type attempt = 0; !try_erase(key, erased); ++attempt) {
+            back_off(attempt);
+        }
+
+        if (erased != 0) {
+            tree_size.fetch_sub(erased, std::memory_order_relaxed);
+        }
+        return erased;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    bool concurrent_radix_tree<Key, T, Split, Len>::try_erase(key_view_type key, size_type& erased) {
+        // keep the last three nodes of the path, a merge rewires the grandparent
+        size_type key_len = get_key_len(key);
+        node* grandparent_node = nullptr;
+        node* parent_node = nullptr;
+        node* erased_node = root_node;
+        std::uint64_t grandparent_version = 0;
+        std::uint64_t parent_version = 0;
+        std::uint64_t version;
+        if (!read_lock(erased_node, version)) {
+            return false;
+        }
+
+        erased = 0;
+        for (size_type cur_key_depth = 0; cur_key_depth < key_len; ) {
+            child_table* table = erased_node->children.load(std::memory_order_acquire);
+            node* child_node = table == nullptr ? nullptr : table->find(key_unit(key, cur_key_depth));
+            if (child_node == nullptr) {
+                return validate(erased_node, version);      // cannot find
+            }
+
+            std::uint64_t child_version;
+            if (!read_lock(child_node, child_version) || !validate(erased_node, version)) {
+                return false;
+            }
+
+            if (!match_label(key, cur_key_depth, child_node)) {
+                return true;        // cannot find
+            }
+
+            cur_key_depth += child_node->label_len;
+            grandparent_node = parent_node;
+            grandparent_version = parent_version;
+            parent_node = erased_node;
+            parent_version = version;
+            erased_node = child_node;
+            version = child_version;
+        }
+
+        mapped_type* value = erased_node->value.load(std::memory_order_acquire);
+        if (value == nullptr) {
+            return validate(erased_node, version);      // cannot find
+        }
+
+        pending_objects pending;
+        child_table* table = erased_node->children.load(std::memory_order_acquire);
+        size_type child_count = table == nullptr ? 0 : table->count;
+        if (erased_node == root_node || child_count >= 2) {
+            // the node still branches, only drop the value
+            if (!upgrade_to_write_lock(erased_node, version)) {
+                return false;
+            }
+            erased_node->value.store(nullptr, std::memory_order_release);
+            write_unlock(erased_node);
+            retire(value, free_value);
+            erased = 1;
+            return true;
+        }
+
+        child_table* parent_table = parent_node->children.load(std::memory_order_acquire);
+        if (!validate(parent_node, parent_version)) {
+            return false;       // parent table is not the one that led to erased node anymore
+        }
+
+        if (child_count == 1) {
+            // merge erased node with its only child
+            node* only_child = nullptr;
+            table->for_each([&only_child](unit_type, node* child_node) {
+                only_child = child_node;
+            });
+            node* merged_node = pending.add(create_node(erased_node->get_search_key(), only_child->get_search_key()), free_node);
+            child_table* new_parent_table = pending.add(
+                    child_table::with_child(parent_table, erased_node->get_search_unit(), merged_node), free_table);
+
+            std::uint64_t child_version;
+            if (!upgrade_to_write_lock(parent_node, parent_version)) {
+                return false;
+            }
+            if (!upgrade_to_write_lock(erased_node, version)) {
+                write_unlock(parent_node);
+                return false;
+            }
+            if (!read_lock(only_child, child_version) || !upgrade_to_write_lock(only_child, child_version)) {
+                write_unlock(erased_node);
+                write_unlock(parent_node);
+                return false;
+            }
+            merged_node->children.store(only_child->children.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            merged_node->value.store(only_child->value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            parent_node->children.store(new_parent_table, std::memory_order_release);
+            write_unlock_obsolete(only_child);
+            write_unlock_obsolete(erased_node);
+            write_unlock(parent_node);
+            pending.publish();
+            retire(parent_table, free_table);
+            retire(table, free_table);
+            retire(erased_node, free_node);
+            retire(only_child, free_node);
+            retire(value, free_value);
+            erased = 1;
+            return true;
+        }
+
+        // erased node is a leaf, unlink it from its parent
+        bool merge_parent = parent_node != root_node && parent_table->count == 2 &&
+                            parent_node->value.load(std::memory_order_acquire) == nullptr;
+        if (!merge_parent) {
+            child_table* new_parent_table = pending.add(
+                    child_table::without_child(parent_table, erased_node->get_search_unit()), free_table);
+            if (!upgrade_to_write_lock(parent_node, parent_version)) {
+                return false;
+            }
+            if (!upgrade_to_write_lock(erased_node, version)) {
+                write_unlock(parent_node);
+                return false;
+            }
+            parent_node->children.store(new_parent_table, std::memory_order_release);
+            write_unlock_obsolete(erased_node);
+            write_unlock(parent_node);
+            pending.publish();
+            retire(parent_table, free_table);
+            retire(erased_node, free_node);
+            retire(value, free_value);
+            erased = 1;
+            return true;
+        }
+
+        /**
+         * Parent is left without value and with a single child, merge it with the sibling of erased node
+         *
+         *      grandparent                grandparent
+         *           |                          |
+         *         parent          ====>   parent + sibling
+         *         /    \
+         *     erased  sibling
+         */
+        node* sibling_node = nullptr;
+        parent_table->for_each([&sibling_node, erased_node](unit_type, node* child_node) {
+            if (child_node != erased_node) {
+                sibling_node = child_node;
+            }
+        });
+        child_table* grandparent_table = grandparent_node->children.load(std::memory_order_acquire);
+        if (!validate(grandparent_node, grandparent_version)) {
+            return false;
+        }
+        node* merged_node = pending.add(create_node(parent_node->get_search_key(), sibling_node->get_search_key()), free_node);
+        child_table* new_grandparent_table = pending.add(
+                child_table::with_child(grandparent_table, parent_node->get_search_unit(), merged_node), free_table);
+
+        std::uint64_t sibling_version;
+        if (!upgrade_to_write_lock(grandparent_node, grandparent_version)) {
+            return false;
+        }
+        if (!upgrade_to_write_lock(parent_node, parent_version)) {
+            write_unlock(grandparent_node);
+            return false;
+        }
+        if (!upgrade_to_write_lock(erased_node, version)) {
+            write_unlock(parent_node);
+            write_unlock(grandparent_node);
+            return false;
+        }
+        if (!read_lock(sibling_node, sibling_version) || !upgrade_to_write_lock(sibling_node, sibling_version)) {
+            write_unlock(erased_node);
+            write_unlock(parent_node);
+            write_unlock(grandparent_node);
+            return false;
+        }
+        merged_node->children.store(sibling_node->children.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        merged_node->value.store(sibling_node->value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        grandparent_node->children.store(new_grandparent_table, std::memory_order_release);
+        write_unlock_obsolete(sibling_node);
+        write_unlock_obsolete(erased_node);
+        write_unlock_obsolete(parent_node);
+        write_unlock(grandparent_node);
+        pending.publish();
+        retire(grandparent_table, free_table);
+        retire(parent_table, free_table);
+        retire(parent_node, free_node);
+        retire(erased_node, free_node);
+        retire(sibling_node, free_node);
+        retire(value, free_value);
+        erased = 1;
+        return true;
+    }
+}
+
+#endif //PHAM_PHI_LONG_CONCURRENT_RADIX_TREE_H
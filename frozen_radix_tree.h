@@ -0,0 +1,596 @@
+//
+// Read-only radix tree over a pointer-free binary image, e.g. a memory mapped file.
+//
+
+#ifndef PHAM_PHI_LONG_FROZEN_RADIX_TREE_H
+#define PHAM_PHI_LONG_FROZEN_RADIX_TREE_H
+
+#include "radix_tree.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace phamphilong {
+    /**
+     * Layout of a frozen image. Everything is in native byte order, positions are counted in 8 byte words from the
+     * start of the image, so a 32 bit position addresses 32 GiB.
+     *
+     *      header | root record | records of the subtree of its first child | ... of its last child
+     *
+     * Records are written in pre-order, the subtree of a node is the run of records from the node to subtree_end, and
+     * the next record is always a child of the current one or of one of its ancestors. A record is
+     *
+     *      node | child positions (uint32_t, in unit order) | child units | label | value (if any) | padding
+     */
+    template <typename CharT, typename T>
+    struct frozen_radix_tree_format {
+        using size_type = std::size_t;
+        using unit_type = unsigned char;
+        using position_type = std::uint32_t;
+
+        static_assert(std::is_trivially_copyable<T>::value, "frozen values are copied byte by byte");
+        static_assert(alignof(T) <= 8 && alignof(CharT) <= 8, "frozen records are 8 byte aligned");
+        static_assert(sizeof(CharT) == 1, "children are indexed by one byte units, keys of wider units would share slots");
+
+        static constexpr size_type word_size = 8;
+        static constexpr std::uint32_t byte_order_mark = 0x01020304;
+        static constexpr std::uint32_t format_version = 1;
+
+        struct header {
+            char magic[8];
+            std::uint32_t byte_order;
+            std::uint32_t version;
+            std::uint32_t unit_size;
+            std::uint32_t value_size;
+            std::uint32_t value_alignment;
+            position_type root;             // 0 for an empty tree
+            std::uint64_t key_count;
+            std::uint64_t image_words;
+        };
+
+        struct node {
+            std::uint32_t label_len;
+            std::uint32_t depth;            // length of the key up to the end of this node
+            position_type subtree_end;      // first record after the subtree of this node
+            std::uint16_t child_count;
+            std::uint8_t has_value;
+            std::uint8_t reserved;
+        };
+
+        static constexpr char magic[8] = {'R', 'D', 'X', 'F', 'R', 'O', 'Z', '\0'};
+
+        static constexpr size_type align(const size_type offset, const size_type alignment) {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        static constexpr size_type units_offset(const size_type child_count) {
+            return sizeof(node) + child_count * sizeof(position_type);
+        }
+
+        static constexpr size_type label_offset(const size_type child_count) {
+            return align(units_offset(child_count) + child_count, alignof(CharT));
+        }
+
+        static constexpr size_type value_offset(const size_type child_count, const size_type label_len) {
+            return align(label_offset(child_count) + label_len * sizeof(CharT), alignof(T));
+        }
+
+        static constexpr size_type record_size(const size_type child_count, const size_type label_len, const bool has_value) {
+            return align(value_offset(child_count, label_len) + (has_value ? sizeof(T) : 0), word_size);
+        }
+
+        static constexpr size_type header_words = align(sizeof(header), word_size) / word_size;
+
+        static const node* node_at(const char* image, const std::uint64_t position) {
+            return reinterpret_cast<const node*>(image + position * word_size);
+        }
+
+        static const node* checked_node_at(const char* image, const std::uint64_t image_words, const std::uint64_t position) {
+            // a position read from the image is only followed once its record is known to lie inside the image
+            if (position < header_words || position >= image_words || image_words - position < sizeof(node) / word_size) {
+                throw std::invalid_argument("frozen_radix_tree: corrupt image, position out of bounds");
+            }
+
+            const node* record = node_at(image, position);
+            if (record_size(record->child_count, record->label_len, record->has_value) / word_size > image_words - position ||
+                record->label_len > record->depth || record->depth > image_words * word_size ||
+                record->subtree_end <= position || record->subtree_end > image_words) {
+                throw std::invalid_argument("frozen_radix_tree: corrupt image, record out of bounds");
+            }
+            return record;
+        }
+
+        static const position_type* children(const node* record) {
+            return reinterpret_cast<const position_type*>(reinterpret_cast<const char*>(record) + sizeof(node));
+        }
+
+        static const unit_type* units(const node* record) {
+            return reinterpret_cast<const unit_type*>(record) + units_offset(record->child_count);
+        }
+
+        static const CharT* label(const node* record) {
+            return reinterpret_cast<const CharT*>(reinterpret_cast<const char*>(record) + label_offset(record->child_count));
+        }
+
+        static const T* value(const node* record) {
+            return reinterpret_cast<const T*>(reinterpret_cast<const char*>(record) + value_offset(record->child_count, record->label_len));
+        }
+
+        static std::uint64_t next_position(const node* record, const std::uint64_t position) {
+            return position + record_size(record->child_count, record->label_len, record->has_value) / word_size;
+        }
+    };
+
+    template <typename Key, typename T, typename Split, typename Len> class frozen_radix_tree;
+
+    /**
+     * Walks the records in image order. Every record it moves to hangs below the current path, so the key is kept by
+     * cutting it at the parent and appending the label, like radix_tree_iterator.
+     */
+    template <typename Key, typename T, typename Split, typename Len>
+    class frozen_radix_tree_iterator {
+        friend class frozen_radix_tree<Key, T, Split, Len>;
+
+    public:
+        using mapped_type = T;
+        using key_type = Key;
+        using value_type = std::pair<const key_type , mapped_type>;
+        using reference = std::pair<const key_type&, const mapped_type&>;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        struct pointer {
+            reference ref;
+
+            reference* operator-> () {
+                return &ref;
+            }
+        };
+
+        frozen_radix_tree_iterator() = default;
+
+        reference operator* () const {
+            return reference{key(), value()};
+        }
+
+        pointer operator-> () const {
+            return pointer{**this};
+        }
+
+        const key_type& key() const;
+
+        const mapped_type& value() const {
+            return *format::value(format::node_at(image, position));
+        }
+
+        const frozen_radix_tree_iterator& operator++ () {
+            move_to_value(format::next_position(format::node_at(image, position), position));
+            return *this;
+        }
+
+        frozen_radix_tree_iterator operator++ (int) {
+            auto temp = *this;
+            ++*this;
+            return temp;
+        }
+
+        bool operator!= (const frozen_radix_tree_iterator& lhs) const {
+            return position != lhs.position;
+        }
+
+        bool operator== (const frozen_radix_tree_iterator& lhs) const {
+            return position == lhs.position;
+        }
+
+    private:
+        using key_view_type = typename Split::view_type;
+        using char_type = typename key_view_type::value_type;
+        using format = frozen_radix_tree_format<char_type, mapped_type>;
+
+        frozen_radix_tree_iterator(const char* image, const std::uint64_t image_words, const std::uint64_t position,
+                                   std::basic_string<char_type> units = {})
+                : image{image}, image_words{image_words}, end_position{image_words}, position{position}, key_units{std::move(units)} {}
+
+        const char* image{nullptr};
+        std::uint64_t image_words{0};
+        std::uint64_t end_position{0};                  // where the walk stops, image_words unless in a range
+        std::uint64_t position{0};                      // end_position at the end
+        std::basic_string<char_type> key_units{};       // key up to the end of the record at position
+        mutable key_type cached_key{};
+        mutable bool key_cached{false};
+
+        void move_to_value(std::uint64_t next);
+    };
+
+    template <typename Key, typename T, typename Split, typename Len>
+    const typename frozen_radix_tree_iterator<Key, T, Split, Len>::key_type& frozen_radix_tree_iterator<Key, T, Split, Len>::key() const {
+        if constexpr (std::is_same<key_type, std::basic_string<char_type>>::value) {
+            return key_units;
+        } else {
+            if (!key_cached) {
+                cached_key = key_type{key_view_type(key_units.data(), key_units.size())};
+                key_cached = true;
+            }
+            return cached_key;
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    void frozen_radix_tree_iterator<Key, T, Split, Len>::move_to_value(std::uint64_t next) {
+        // a record without a value always has children, so the first value is at most the depth of the tree away
+        key_cached = false;
+        for (; next < end_position; ) {
+            const typename format::node* record = format::checked_node_at(image, image_words, next);
+            key_units.resize(record->depth - record->label_len);
+            key_units.append(format::label(record), record->label_len);
+            if (record->has_value) {
+                break;
+            }
+            next = format::next_position(record, next);
+        }
+        position = next < end_position ? next : end_position;
+    }
+
+    /**
+     * Read-only view of the image written by write(): find, prefix queries and iteration run on the bytes directly,
+     * nothing is copied nor allocated but the key kept by iterators. The image is not owned, it must stay mapped
+     * and 8 byte aligned (a memory map always is) while the view and its iterators are used.
+     *
+     *      {
+     *          std::ofstream out("dict.rdx", std::ios::binary);
+     *          frozen_radix_tree<std::string, int>::write(tree, out);
+     *      }
+     *      radix_tree_mapped_file file("dict.rdx");
+     *      frozen_radix_tree<std::string, int> frozen(file.data(), file.size());
+     *      frozen.find("abc");
+     *
+     * Values must be trivially copyable, they are stored byte by byte; images are only readable by a build with the
+     * same value type, unit size and byte order, which the constructor checks.
+     *
+     * The image does not have to be trusted for memory safety: the constructor checks the header and the root, and
+     * every position read from the image is checked before the record there is read, a record that does not lie
+     * inside the image throws std::invalid_argument. A corrupt image that stays in bounds can still yield wrong keys
+     * or values.
+     */
+    template <typename Key, typename T, typename Split = split<Key>, typename Len = radix_len<Key>>
+    class frozen_radix_tree {
+    public:
+        using mapped_type = T;
+        using key_type = Key;
+        using iterator = frozen_radix_tree_iterator<key_type, mapped_type, Split, Len>;
+        using value_type = std::pair<const key_type , mapped_type>;
+        using size_type = std::size_t;
+        using key_view_type = typename Split::view_type;
+        using range = radix_tree_range<iterator>;
+
+        static constexpr size_type no_limit = std::numeric_limits<size_type>::max();
+
+        frozen_radix_tree() = default;
+        frozen_radix_tree(const void* image, const size_type image_size);
+
+        template <typename Allocator>
+        static void write(const radix_tree<Key, T, Split, Len, Allocator>& tree, std::ostream& out);
+
+        iterator begin() const;
+        iterator end() const noexcept;
+        iterator find(key_view_type key) const;
+        range find_with_prefix(key_view_type prefix, const size_type limit = no_limit) const;
+
+        size_type size() const noexcept {
+            return key_count;
+        }
+
+        bool empty() const noexcept {
+            return key_count == 0;
+        }
+
+    private:
+        using char_type = typename key_view_type::value_type;
+        using format = frozen_radix_tree_format<char_type, mapped_type>;
+        using frozen_node = typename format::node;
+        using tree_node_type = radix_tree_node<key_type, mapped_type, Split, Len>;
+        using unit_type = typename format::unit_type;
+
+        const char* image{nullptr};
+        std::uint64_t image_words{0};
+        std::uint64_t root{0};
+        size_type key_count{0};
+        Split split_key{};
+        Len get_key_len{};
+
+        static unit_type key_unit(key_view_type key, const size_type pos) {
+            return static_cast<unit_type>(key[pos]);
+        }
+
+        static std::uint64_t find_child(const frozen_node* record, const unit_type unit) {
+            // position of the child whose label starts with unit, 0 if there is none
+            const unit_type* units = format::units(record);
+            const unit_type* found = std::lower_bound(units, units + record->child_count, unit);
+            return found != units + record->child_count && *found == unit ? format::children(record)[found - units] : 0;
+        }
+
+        key_view_type label_of(const frozen_node* record) const {
+            return key_view_type(format::label(record), record->label_len);
+        }
+
+        static void write_subtree(const tree_node_type* subtree_root, std::vector<char>& image_bytes);
+        static typename format::position_type to_position(const size_type offset);
+    };
+
+    template <typename Key, typename T, typename Split, typename Len>
+    frozen_radix_tree<Key, T, Split, Len>::frozen_radix_tree(const void* image, const size_type image_size) : image{static_cast<const char*>(image)} {
+        using header_type = typename format::header;
+        if (reinterpret_cast<std::uintptr_t>(image) % format::word_size != 0 || image_size < sizeof(header_type)) {
+            throw std::invalid_argument("frozen_radix_tree: image is not 8 byte aligned or too short");
+        }
+
+        header_type header;
+        std::memcpy(&header, image, sizeof(header));
+        if (std::memcmp(header.magic, format::magic, sizeof(header.magic)) != 0 || header.version != format::format_version) {
+            throw std::invalid_argument("frozen_radix_tree: not a frozen radix tree image");
+        }
+        if (header.byte_order != format::byte_order_mark || header.unit_size != sizeof(char_type) ||
+            header.value_size != sizeof(mapped_type) || header.value_alignment != alignof(mapped_type)) {
+            throw std::invalid_argument("frozen_radix_tree: image written for another byte order, key or value type");
+        }
+        if (header.image_words > image_size / format::word_size) {
+            throw std::invalid_argument("frozen_radix_tree: truncated image");
+        }
+
+        image_words = header.image_words;
+        root = header.root;
+        key_count = static_cast<size_type>(header.key_count);
+        if (key_count != 0) {
+            format::checked_node_at(this->image, image_words, root);
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    template <typename Allocator>
+    void frozen_radix_tree<Key, T, Split, Len>::write(const radix_tree<Key, T, Split, Len, Allocator>& tree, std::ostream& out) {
+        // the image is built in memory, child positions are patched in once the subtrees before them are written
+        typename format::header header{};
+        std::memcpy(header.magic, format::magic, sizeof(header.magic));
+        header.byte_order = format::byte_order_mark;
+        header.version = format::format_version;
+        header.unit_size = sizeof(char_type);
+        header.value_size = sizeof(mapped_type);
+        header.value_alignment = alignof(mapped_type);
+        header.key_count = tree.size();
+
+        std::vector<char> image_bytes(sizeof(header));
+        if (tree.root_node != nullptr && tree.size() != 0) {
+            header.root = to_position(image_bytes.size());
+            write_subtree(tree.root_node, image_bytes);
+        }
+        header.image_words = image_bytes.size() / format::word_size;
+        std::memcpy(image_bytes.data(), &header, sizeof(header));
+        out.write(image_bytes.data(), static_cast<std::streamsize>(image_bytes.size()));
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    void frozen_radix_tree<Key, T, Split, Len>::write_subtree(const tree_node_type* subtree_root, std::vector<char>& image_bytes) {
+        /**
+         * Pre-order walk with an explicit stack of the records still open, so that deep trees do not grow the call
+         * stack: a record is written when its node is reached, then every child position is patched in just before
+         * the subtree of that child is written, and subtree_end once the last child is done.
+         */
+        struct open_record {
+            const tree_node_type* node;
+            size_type offset;                       // image_bytes grows, so every access goes through the offset
+            size_type child_index;
+            const tree_node_type* next_child;
+        };
+
+        auto write_record = [&image_bytes](const tree_node_type* node) {
+            size_type child_count = node->children.size();
+            size_type offset = image_bytes.size();
+            image_bytes.resize(offset + format::record_size(child_count, node->label_len, node->has_value()));
+
+            frozen_node record{};
+            record.label_len = node->label_len;
+            record.depth = node->depth;
+            record.child_count = static_cast<std::uint16_t>(child_count);
+            record.has_value = node->has_value() ? 1 : 0;
+            std::memcpy(&image_bytes[offset], &record, sizeof(record));
+            std::memcpy(&image_bytes[offset + format::label_offset(child_count)], node->label_data(), node->label_len * sizeof(char_type));
+            if (node->has_value()) {
+                std::memcpy(&image_bytes[offset + format::value_offset(child_count, node->label_len)], node->value, sizeof(mapped_type));
+            }
+            return open_record{node, offset, 0, node->children.first()};
+        };
+
+        std::vector<open_record> open_records;
+        open_records.push_back(write_record(subtree_root));
+        while (!open_records.empty()) {
+            open_record& parent = open_records.back();
+            const tree_node_type* child_node = parent.next_child;
+            if (child_node == nullptr) {
+                typename format::position_type subtree_end = to_position(image_bytes.size());
+                std::memcpy(&image_bytes[parent.offset + offsetof(frozen_node, subtree_end)], &subtree_end, sizeof(subtree_end));
+                open_records.pop_back();
+                continue;
+            }
+
+            size_type child_count = parent.node->children.size();
+            typename format::position_type child_position = to_position(image_bytes.size());
+            std::memcpy(&image_bytes[parent.offset + sizeof(frozen_node) + parent.child_index * sizeof(child_position)], &child_position, sizeof(child_position));
+            image_bytes[parent.offset + format::units_offset(child_count) + parent.child_index] = static_cast<char>(child_node->get_search_unit());
+            ++parent.child_index;
+            parent.next_child = parent.node->children.next(child_node->get_search_unit());
+
+            // parent is not used past this point, the push may move it
+            open_records.push_back(write_record(child_node));
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename frozen_radix_tree<Key, T, Split, Len>::format::position_type frozen_radix_tree<Key, T, Split, Len>::to_position(const size_type offset) {
+        if (offset / format::word_size > std::numeric_limits<typename format::position_type>::max()) {
+            throw std::length_error("frozen_radix_tree: image larger than 32 GiB");
+        }
+        return static_cast<typename format::position_type>(offset / format::word_size);
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename frozen_radix_tree<Key, T, Split, Len>::iterator frozen_radix_tree<Key, T, Split, Len>::begin() const {
+        if (key_count == 0) {
+            return end();
+        }
+
+        iterator first{image, image_words, root};
+        first.move_to_value(root);
+        return first;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    inline typename frozen_radix_tree<Key, T, Split, Len>::iterator frozen_radix_tree<Key, T, Split, Len>::end() const noexcept {
+        return iterator{image, image_words, image_words};
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename frozen_radix_tree<Key, T, Split, Len>::iterator frozen_radix_tree<Key, T, Split, Len>::find(key_view_type key) const {
+        if (key_count == 0) {
+            return end();
+        }
+
+        size_type key_len = get_key_len(key);
+        std::uint64_t position = root;
+        for (size_type cur_key_depth = 0; cur_key_depth < key_len; ) {
+            position = find_child(format::node_at(image, position), key_unit(key, cur_key_depth));
+            if (position == 0) {
+                return end();       // cannot find
+            }
+
+            const frozen_node* child = format::checked_node_at(image, image_words, position);
+            if (child->label_len > key_len - cur_key_depth || split_key(key, cur_key_depth, child->label_len) != label_of(child)) {
+                return end();       // cannot find
+            }
+            cur_key_depth += child->label_len;
+        }
+
+        if (!format::node_at(image, position)->has_value) {
+            return end();
+        }
+        return iterator{image, image_words, position, std::basic_string<char_type>(key.data(), key_len)};
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename frozen_radix_tree<Key, T, Split, Len>::range frozen_radix_tree<Key, T, Split, Len>::find_with_prefix(key_view_type prefix, const size_type limit) const {
+        // same walk as radix_tree::find_prefix_node, the subtree of the node found is one run of records
+        if (key_count == 0 || limit == 0) {
+            return range{end(), end()};
+        }
+
+        size_type prefix_len = get_key_len(prefix);
+        std::uint64_t position = root;
+        size_type node_start = 0;           // length of the key before the label of the node at position
+        for (size_type cur_key_depth = 0; cur_key_depth < prefix_len; ) {
+            position = find_child(format::node_at(image, position), key_unit(prefix, cur_key_depth));
+            if (position == 0) {
+                return range{end(), end()};
+            }
+
+            const frozen_node* child = format::checked_node_at(image, image_words, position);
+            size_type match_len = std::min<size_type>(child->label_len, prefix_len - cur_key_depth);
+            if (split_key(label_of(child), 0, match_len) != split_key(prefix, cur_key_depth, match_len)) {
+                return range{end(), end()};
+            }
+            node_start = cur_key_depth;
+            cur_key_depth += match_len;
+        }
+
+        // the walk to the first value appends the labels from the node on, the key before the node is in prefix
+        const frozen_node* prefix_node = format::node_at(image, position);
+        // first walks no further than last, even if the records of a corrupt image do not end at subtree_end
+        iterator last{image, image_words, prefix_node->subtree_end};
+        last.move_to_value(prefix_node->subtree_end);
+        iterator first{image, image_words, position, std::basic_string<char_type>(prefix.data(), node_start)};
+        first.end_position = last.position;
+        first.move_to_value(position);
+
+        // stop early after `limit` entries, the range end is never further than the end of the subtree
+        if (limit != no_limit) {
+            iterator limited = first;
+            for (size_type count = 0; count < limit && limited != last; ++count) {
+                ++limited;
+            }
+            last = limited;
+        }
+        return range{first, last};
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    /**
+     * Read-only memory map of a whole file, shared with every process mapping the same file.
+     */
+    class radix_tree_mapped_file {
+    public:
+        using size_type = std::size_t;
+
+        explicit radix_tree_mapped_file(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "radix_tree_mapped_file: cannot open " + path);
+            }
+
+            struct stat file_stat;
+            if (::fstat(fd, &file_stat) != 0) {
+                int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "radix_tree_mapped_file: cannot stat " + path);
+            }
+
+            file_size = static_cast<size_type>(file_stat.st_size);
+            if (file_size != 0) {
+                void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    int error = errno;
+                    ::close(fd);
+                    throw std::system_error(error, std::generic_category(), "radix_tree_mapped_file: cannot map " + path);
+                }
+                mapped = static_cast<const char*>(mapping);
+            }
+            ::close(fd);
+        }
+
+        radix_tree_mapped_file(const radix_tree_mapped_file&) = delete;
+        radix_tree_mapped_file& operator= (const radix_tree_mapped_file&) = delete;
+        ~radix_tree_mapped_file() {
+            if (mapped != nullptr) {
+                ::munmap(const_cast<char*>(mapped), file_size);
+            }
+        }
+
+        const char* data() const noexcept {
+            return mapped;
+        }
+
+        size_type size() const noexcept {
+            return file_size;
+        }
+
+    private:
+        const char* mapped{nullptr};
+        size_type file_size{0};
+    };
+#endif
+}
+
+#endif //PHAM_PHI_LONG_FROZEN_RADIX_TREE_H
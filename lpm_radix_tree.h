@@ -0,0 +1,409 @@
+//
+// Bit granular radix tree for longest prefix match, e.g. CIDR routing tables.
+//
+
+#ifndef PHAM_PHI_LONG_LPM_RADIX_TREE_H
+#define PHAM_PHI_LONG_LPM_RADIX_TREE_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace phamphilong {
+    template <typename Key, typename Enable = void> struct radix_bits;
+
+    /**
+     * Bit string customization point, bits are numbered from the most significant one:
+     *      radix_bits<Key>::width                         : number of bits of a key
+     *      radix_bits<Key>::bit(key, index)               : bit `index` of key
+     *      radix_bits<Key>::mask(key, len)                : key with every bit from `len` on cleared, len <= width
+     *      radix_bits<Key>::common_prefix_length(lhs, rhs): number of leading bits both keys share
+     *
+     * Unsigned integers (IPv4 addresses as std::uint32_t, 64 bit keys) work on the word itself, byte arrays (IPv6
+     * addresses as std::array<std::uint8_t, 16>) in network order.
+     */
+    template <typename Key>
+    struct radix_bits<Key, std::enable_if_t<std::is_integral<Key>::value && std::is_unsigned<Key>::value>> {
+        static constexpr std::size_t width = sizeof(Key) * 8;
+
+        static constexpr bool bit(const Key key, const std::size_t index) noexcept {
+            return (key >> (width - 1 - index)) & 1;
+        }
+
+        static constexpr Key mask(const Key key, const std::size_t len) noexcept {
+            return len == 0 ? Key{0} : static_cast<Key>(key & (~0ull << (width - len)));
+        }
+
+        static constexpr std::size_t common_prefix_length(const Key lhs, const Key rhs) noexcept {
+            Key diff = lhs ^ rhs;
+            if (diff == 0) {
+                return width;
+            }
+#if defined(__GNUC__)
+            return static_cast<std::size_t>(__builtin_clzll(static_cast<unsigned long long>(diff))) - (64 - width);
+#else
+            std::size_t len = 0;
+            for (; !bit(diff, len); ++len) {}
+            return len;
+#endif
+        }
+    };
+
+#if defined(__SIZEOF_INT128__)
+    template <>
+    struct radix_bits<unsigned __int128> {
+        using key_type = unsigned __int128;
+
+        static constexpr std::size_t width = 128;
+
+        static constexpr bool bit(const key_type key, const std::size_t index) noexcept {
+            return (key >> (width - 1 - index)) & 1;
+        }
+
+        static constexpr key_type mask(const key_type key, const std::size_t len) noexcept {
+            return len == 0 ? key_type{0} : key & (~key_type{0} << (width - len));
+        }
+
+        static constexpr std::size_t common_prefix_length(const key_type lhs, const key_type rhs) noexcept {
+            // leading zeros of the difference, one half at a time
+            auto high = static_cast<std::uint64_t>((lhs ^ rhs) >> 64);
+            auto low = static_cast<std::uint64_t>(lhs ^ rhs);
+            return high != 0 ? radix_bits<std::uint64_t>::common_prefix_length(high, 0)
+                             : 64 + radix_bits<std::uint64_t>::common_prefix_length(low, 0);
+        }
+    };
+#endif
+
+    template <std::size_t N>
+    struct radix_bits<std::array<std::uint8_t, N>> {
+        using key_type = std::array<std::uint8_t, N>;
+
+        static constexpr std::size_t width = N * 8;
+
+        static constexpr bool bit(const key_type& key, const std::size_t index) noexcept {
+            return (key[index / 8] >> (7 - index % 8)) & 1;
+        }
+
+        static constexpr key_type mask(const key_type& key, const std::size_t len) noexcept {
+            key_type masked{};
+            for (std::size_t i = 0; i < N; ++i) {
+                if (len >= (i + 1) * 8) {
+                    masked[i] = key[i];
+                } else if (len > i * 8) {
+                    masked[i] = static_cast<std::uint8_t>(key[i] & (0xFF << (8 - (len - i * 8))));
+                }
+            }
+            return masked;
+        }
+
+        static constexpr std::size_t common_prefix_length(const key_type& lhs, const key_type& rhs) noexcept {
+            for (std::size_t i = 0; i < N; ++i) {
+                if (lhs[i] != rhs[i]) {
+                    return i * 8 + radix_bits<std::uint8_t>::common_prefix_length(lhs[i], rhs[i]);
+                }
+            }
+            return width;
+        }
+    };
+
+    /**
+     * Read:
+     *      https://en.wikipedia.org/wiki/Radix_tree#PATRICIA
+     * for the definition.
+     *
+     * A binary radix tree of (prefix, prefix length) entries. Every node keeps its whole prefix, so a path is
+     * compressed down to the bit where two prefixes differ, and stepping down tests a single bit:
+     *
+     *      (10.0.0.0/8)
+     *        |____ 0 ____ (10.0.0.0/16)
+     *        |____ 1 ____ (10.128.0.0/9, branch without value)
+     *                       |____ 0 ____ (10.129.0.0/16)
+     *                       |____ 1 ____ (10.192.0.0/10)
+     *
+     * longest_prefix_match(address) descends along the bits of address and returns the deepest entry on the way,
+     * each step is a mask and a compare of the key. Prefix lengths go from 0 to key_width: insert and erase throw
+     * std::out_of_range for longer ones, find finds nothing.
+     */
+    template <
+            typename Key,
+            typename T,
+            typename Bits = radix_bits<Key>,
+            typename Allocator = std::allocator<std::pair<const Key, T>>>
+    class lpm_radix_tree {
+    public:
+        using key_type = Key;
+        using mapped_type = T;
+        using size_type = std::size_t;
+        using allocator_type = Allocator;
+
+        static constexpr size_type key_width = Bits::width;
+
+        struct match {
+            const mapped_type* value;       // nullptr if no prefix matches
+            size_type prefix_len;
+        };
+
+        lpm_radix_tree() = default;
+        explicit lpm_radix_tree(const allocator_type& allocator) : allocator{allocator} {}
+        lpm_radix_tree(const lpm_radix_tree&) = delete;
+        lpm_radix_tree& operator= (const lpm_radix_tree&) = delete;
+        ~lpm_radix_tree() {
+            clear();
+        }
+
+        std::pair<mapped_type*, bool> insert(const key_type& prefix, const size_type prefix_len, const mapped_type& value);
+        mapped_type* find(const key_type& prefix, const size_type prefix_len) const noexcept;
+        match longest_prefix_match(const key_type& address) const noexcept;
+        size_type erase(const key_type& prefix, const size_type prefix_len);
+
+        size_type size() const noexcept {
+            return tree_size;
+        }
+
+        bool empty() const noexcept {
+            return tree_size == 0;
+        }
+
+        void clear() noexcept {
+            destroy_subtree(root_node);
+            root_node = nullptr;
+            tree_size = 0;
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator;
+        }
+
+    private:
+        struct node {
+            key_type prefix;                        // bits from prefix_len on are cleared
+            std::uint32_t prefix_len;
+            node* children[2];                      // by the bit at prefix_len
+            mapped_type* value;                     // only set if a prefix ends at this node
+        };
+
+        using alloc_traits = std::allocator_traits<allocator_type>;
+        using node_allocator_type = typename alloc_traits::template rebind_alloc<node>;
+        using node_alloc_traits = typename alloc_traits::template rebind_traits<node>;
+        using value_allocator_type = typename alloc_traits::template rebind_alloc<mapped_type>;
+        using value_alloc_traits = typename alloc_traits::template rebind_traits<mapped_type>;
+
+        allocator_type allocator{};
+        node* root_node{nullptr};
+        size_type tree_size{0};
+
+        static void check_prefix_len(const size_type prefix_len) {
+            if (prefix_len > key_width) {
+                throw std::out_of_range("lpm_radix_tree: prefix length longer than the key");
+            }
+        }
+
+        static bool covers(const node* prefix_node, const key_type& key) noexcept {
+            // true if the prefix of node is a prefix of key
+            return Bits::mask(key, prefix_node->prefix_len) == prefix_node->prefix;
+        }
+
+        node* create_node(const key_type& prefix, const size_type prefix_len) {
+            node_allocator_type node_allocator(allocator);
+            node* new_node = node_alloc_traits::allocate(node_allocator, 1);
+            ::new (static_cast<void*>(new_node)) node{prefix, static_cast<std::uint32_t>(prefix_len), {nullptr, nullptr}, nullptr};
+            return new_node;
+        }
+
+        void destroy_node(node* old_node) noexcept {
+            destroy_value(old_node->value);
+            old_node->~node();
+            node_allocator_type node_allocator(allocator);
+            node_alloc_traits::deallocate(node_allocator, old_node, 1);
+        }
+
+        mapped_type* create_value(const mapped_type& value) {
+            value_allocator_type value_allocator(allocator);
+            mapped_type* new_value = value_alloc_traits::allocate(value_allocator, 1);
+            try {
+                value_alloc_traits::construct(value_allocator, new_value, value);
+            } catch (...) {
+                value_alloc_traits::deallocate(value_allocator, new_value, 1);
+                throw;
+            }
+            return new_value;
+        }
+
+        void destroy_value(mapped_type* value) noexcept {
+            if (value != nullptr) {
+                value_allocator_type value_allocator(allocator);
+                value_alloc_traits::destroy(value_allocator, value);
+                value_alloc_traits::deallocate(value_allocator, value, 1);
+            }
+        }
+
+        void destroy_subtree(node* subtree_node) noexcept {
+            if (subtree_node != nullptr) {
+                destroy_subtree(subtree_node->children[0]);
+                destroy_subtree(subtree_node->children[1]);
+                destroy_node(subtree_node);
+            }
+        }
+    };
+
+    template <typename Key, typename T, typename Bits, typename Allocator>
+    std::pair<typename lpm_radix_tree<Key, T, Bits, Allocator>::mapped_type*, bool>
+    lpm_radix_tree<Key, T, Bits, Allocator>::insert(const key_type& prefix, const size_type prefix_len, const mapped_type& value) {
+        /**
+         * Walk down while the prefix of the node covers the new one, then either the entry exists, or it hangs below
+         * the last node, or it sits in the middle of an edge:
+         *
+         *      node covers new     : (node) ____ (new)
+         *      new covers node     : (new) ____ (node)
+         *      they differ at bit b: (branch/b) ____ (node)
+         *                                |_____ (new)
+         */
+        check_prefix_len(prefix_len);
+        key_type key = Bits::mask(prefix, prefix_len);
+        node** link = &root_node;
+        while (*link != nullptr) {
+            node* traverse_node = *link;
+            size_type common_len = Bits::common_prefix_length(traverse_node->prefix, key);
+            common_len = std::min<size_type>(common_len, std::min<size_type>(traverse_node->prefix_len, prefix_len));
+            if (common_len < traverse_node->prefix_len) {
+                mapped_type* new_value = create_value(value);
+                node* new_node;
+                try {
+                    new_node = create_node(key, prefix_len);
+                } catch (...) {
+                    destroy_value(new_value);
+                    throw;
+                }
+                new_node->value = new_value;
+
+                if (common_len == prefix_len) {
+                    // new prefix covers the node
+                    new_node->children[Bits::bit(traverse_node->prefix, prefix_len)] = traverse_node;
+                    *link = new_node;
+                } else {
+                    node* branch_node;
+                    try {
+                        branch_node = create_node(Bits::mask(key, common_len), common_len);
+                    } catch (...) {
+                        destroy_node(new_node);
+                        throw;
+                    }
+                    branch_node->children[Bits::bit(traverse_node->prefix, common_len)] = traverse_node;
+                    branch_node->children[Bits::bit(key, common_len)] = new_node;
+                    *link = branch_node;
+                }
+                ++tree_size;
+                return {new_value, true};
+            }
+
+            if (traverse_node->prefix_len == prefix_len) {
+                if (traverse_node->value != nullptr) {
+                    return {traverse_node->value, false};
+                }
+                traverse_node->value = create_value(value);
+                ++tree_size;
+                return {traverse_node->value, true};
+            }
+
+            link = &traverse_node->children[Bits::bit(key, traverse_node->prefix_len)];
+        }
+
+        mapped_type* new_value = create_value(value);
+        try {
+            *link = create_node(key, prefix_len);
+        } catch (...) {
+            destroy_value(new_value);
+            throw;
+        }
+        (*link)->value = new_value;
+        ++tree_size;
+        return {new_value, true};
+    }
+
+    template <typename Key, typename T, typename Bits, typename Allocator>
+    typename lpm_radix_tree<Key, T, Bits, Allocator>::mapped_type*
+    lpm_radix_tree<Key, T, Bits, Allocator>::find(const key_type& prefix, const size_type prefix_len) const noexcept {
+        // exact (prefix, prefix_len) entry
+        if (prefix_len > key_width) {
+            return nullptr;
+        }
+
+        key_type key = Bits::mask(prefix, prefix_len);
+        node* traverse_node = root_node;
+        while (traverse_node != nullptr && traverse_node->prefix_len < prefix_len && covers(traverse_node, key)) {
+            traverse_node = traverse_node->children[Bits::bit(key, traverse_node->prefix_len)];
+        }
+
+        if (traverse_node == nullptr || traverse_node->prefix_len != prefix_len || traverse_node->prefix != key) {
+            return nullptr;
+        }
+        return traverse_node->value;
+    }
+
+    template <typename Key, typename T, typename Bits, typename Allocator>
+    typename lpm_radix_tree<Key, T, Bits, Allocator>::match
+    lpm_radix_tree<Key, T, Bits, Allocator>::longest_prefix_match(const key_type& address) const noexcept {
+        match best{nullptr, 0};
+        node* traverse_node = root_node;
+        while (traverse_node != nullptr && covers(traverse_node, address)) {
+            if (traverse_node->value != nullptr) {
+                best = match{traverse_node->value, traverse_node->prefix_len};
+            }
+            if (traverse_node->prefix_len == key_width) {
+                break;
+            }
+            traverse_node = traverse_node->children[Bits::bit(address, traverse_node->prefix_len)];
+        }
+        return best;
+    }
+
+    template <typename Key, typename T, typename Bits, typename Allocator>
+    typename lpm_radix_tree<Key, T, Bits, Allocator>::size_type
+    lpm_radix_tree<Key, T, Bits, Allocator>::erase(const key_type& prefix, const size_type prefix_len) {
+        // drop the value, then the nodes that no longer branch: a node keeps either a value or two children
+        check_prefix_len(prefix_len);
+        key_type key = Bits::mask(prefix, prefix_len);
+        node** parent_link = nullptr;
+        node** link = &root_node;
+        while (*link != nullptr && (*link)->prefix_len < prefix_len && covers(*link, key)) {
+            parent_link = link;
+            link = &(*link)->children[Bits::bit(key, (*link)->prefix_len)];
+        }
+
+        node* erased_node = *link;
+        if (erased_node == nullptr || erased_node->prefix_len != prefix_len || erased_node->prefix != key ||
+            erased_node->value == nullptr) {
+            return 0;
+        }
+
+        destroy_value(erased_node->value);
+        erased_node->value = nullptr;
+        --tree_size;
+
+        if (erased_node->children[0] != nullptr && erased_node->children[1] != nullptr) {
+            return 1;       // still a branch
+        }
+
+        // replace the node by its only child, if any
+        *link = erased_node->children[0] != nullptr ? erased_node->children[0] : erased_node->children[1];
+        destroy_node(erased_node);
+
+        // a parent branch left with a single child goes away too
+        if (parent_link != nullptr && *link == nullptr) {
+            node* parent_node = *parent_link;
+            if (parent_node->value == nullptr) {
+                *parent_link = parent_node->children[0] != nullptr ? parent_node->children[0] : parent_node->children[1];
+                parent_node->children[0] = parent_node->children[1] = nullptr;
+                destroy_node(parent_node);
+            }
+        }
+        return 1;
+    }
+}
+
+#endif //PHAM_PHI_LONG_LPM_RADIX_TREE_H
@@ -21,6 +21,10 @@ int main () {
         std::cout << "key: " << it->first << ";        value: " << it->second << std::endl;
     }
 
+    for (auto entry : radix_tree.find_with_prefix("abc")) {
+        std::cout << "prefix abc, key: " << entry.first << ";        value: " << entry.second << std::endl;
+    }
+
     radix_tree.erase("abg");
     std::cout << radix_tree.size() << std::endl;
     for (auto it = radix_tree.begin(); it != radix_tree.end(); ++it) {
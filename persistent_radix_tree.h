@@ -0,0 +1,641 @@
+//
+// Persistent radix tree: path copying updates and O(1) snapshots for consistent readers.
+//
+
+#ifndef PHAM_PHI_LONG_PERSISTENT_RADIX_TREE_H
+#define PHAM_PHI_LONG_PERSISTENT_RADIX_TREE_H
+
+#include "radix_tree_iterator.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace phamphilong {
+    /**
+     * Read:
+     *      https://en.wikipedia.org/wiki/Persistent_data_structure#Path_copying
+     * for path copying.
+     *
+     * Same keys and customization points as radix_tree, but the versions of the tree share their nodes. insert and
+     * erase never modify a node another version can see, they copy the nodes on the path from the root down to the
+     * key instead. Every node counts the versions and parents referencing it, values are shared by the copies.
+     *
+     *      version 1           version 2 = version 1 + insert("abd")
+     *
+     *        ROOT                ROOT'             ROOT' and "ab'" are copies, "c", "x" and all the values
+     *         |                   |                are shared by both versions
+     *        ab                  ab'
+     *       /  \               /  |  \
+     *      c    x             c   d   x
+     *
+     * snapshot() is O(1), it only references the current root: the snapshot keeps its version alive and unchanged
+     * for as long as it exists. Any number of threads can copy, query, iterate and destroy snapshots without locks
+     * while the tree moves on. The tree itself has one writer at a time, like radix_tree, and snapshot() belongs to
+     * the writer's side. Whoever drops the last reference to a node frees it.
+     *
+     * A node only the current version references, i.e. created or copied since the last snapshot, is updated in
+     * place, so without snapshots insert and erase do not copy anything.
+     */
+    template <typename Key, typename T, typename Split = split<Key>, typename Len = radix_len<Key>>
+    class persistent_radix_tree {
+        struct node;
+
+    public:
+        using mapped_type = T;
+        using key_type = Key;
+        using value_type = std::pair<const key_type , mapped_type>;
+        using size_type = std::size_t;
+        using key_view_type = typename Split::view_type;
+        using unit_type = unsigned char;
+        static_assert(sizeof(typename key_view_type::value_type) == 1, "children are indexed by one byte units, keys of wider units would share slots");
+
+        class const_iterator;
+        class snapshot_type;
+        using range = radix_tree_range<const_iterator>;
+
+        persistent_radix_tree() = default;
+        persistent_radix_tree(const persistent_radix_tree& other) noexcept
+                : root_node{retain(other.root_node)}, tree_size{other.tree_size} {}
+        persistent_radix_tree(persistent_radix_tree&& other) noexcept
+                : root_node{std::exchange(other.root_node, nullptr)}, tree_size{std::exchange(other.tree_size, 0)} {}
+        persistent_radix_tree& operator= (persistent_radix_tree other) noexcept {
+            // copying shares the version of other, it is O(1) as well
+            swap(other);
+            return *this;
+        }
+        ~persistent_radix_tree() {
+            release(root_node);
+        }
+
+        const mapped_type* find(key_view_type key) const noexcept;
+        bool insert(const value_type& value);
+        bool insert(value_type&& value);
+        template <typename M> bool insert_or_assign(key_view_type key, M&& obj);
+        size_type erase(key_view_type key);
+        void clear() noexcept;
+        void swap(persistent_radix_tree& other) noexcept;
+        snapshot_type snapshot() const noexcept;
+
+        size_type size() const noexcept {
+            return tree_size;
+        }
+
+        bool empty() const noexcept {
+            return tree_size == 0;
+        }
+
+    private:
+        using char_type = typename key_view_type::value_type;
+        using label_type = std::basic_string<char_type>;
+
+        struct node {
+            std::atomic<std::uintptr_t> reference_count{1};     // versions and parents referencing the node
+            label_type label{};                                 // edge label from the parent
+            std::shared_ptr<const mapped_type> value{};         // only set if a key ends at this node
+            std::vector<node*> children{};                      // sorted by the first unit of their labels
+
+            key_view_type get_search_key() const noexcept {
+                return key_view_type(label.data(), label.size());
+            }
+
+            unit_type get_search_unit() const noexcept {
+                return static_cast<unit_type>(label[0]);
+            }
+        };
+
+        node* root_node{nullptr};
+        size_type tree_size{0};
+
+        static size_type key_length(key_view_type key) {
+            return Len{}(key);
+        }
+
+        static key_view_type sub_key(key_view_type key, const size_type start, const size_type len) {
+            return Split{}(key, start, len);
+        }
+
+        static key_view_type sub_key(key_view_type key, const size_type start) {
+            return Split{}(key, start);
+        }
+
+        static unit_type key_unit(key_view_type key, const size_type pos) {
+            return static_cast<unit_type>(key[pos]);
+        }
+
+        static size_type common_prefix_length(key_view_type lhs, key_view_type rhs) {
+            size_type len = std::min(key_length(lhs), key_length(rhs));
+            size_type i = 0;
+            while (i < len && lhs[i] == rhs[i]) {
+                ++i;
+            }
+            return i;
+        }
+
+        template <typename Node>
+        static auto child_position(Node* parent_node, const unit_type unit) noexcept {
+            // position of the child indexed by unit, or where it would go
+            return std::lower_bound(parent_node->children.begin(), parent_node->children.end(), unit,
+                                    [](const node* child_node, const unit_type child_unit) {
+                                        return child_node->get_search_unit() < child_unit;
+                                    });
+        }
+
+        static node* retain(node* referenced_node) noexcept {
+            if (referenced_node != nullptr) {
+                referenced_node->reference_count.fetch_add(1, std::memory_order_relaxed);
+            }
+            return referenced_node;
+        }
+
+        static bool unreference(node* referenced_node) noexcept {
+            // true if that was the last reference
+            return referenced_node->reference_count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+
+        static void release(node* released_node) noexcept;
+        static node* copy_node(const node* source_node);
+        static node* own(node*& slot);
+        static const node* find_node(const node* start_node, key_view_type key) noexcept;
+        static const node* find_prefix_node(const node* start_node, key_view_type prefix, label_type& path_key);
+        bool put(key_view_type key, std::shared_ptr<const mapped_type> value);
+        void merge_with_only_child(node* parent_node, node* merged_node);
+    };
+
+    /**
+     * Forward iterator over one version, in key order. It refers to the nodes of that version without referencing
+     * them: the snapshot it comes from has to outlive it.
+     */
+    template <typename Key, typename T, typename Split, typename Len>
+    class persistent_radix_tree<Key, T, Split, Len>::const_iterator {
+        friend class persistent_radix_tree;
+        friend class snapshot_type;
+
+    public:
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using reference = std::pair<const key_type&, const mapped_type&>;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        struct pointer {
+            reference ref;
+
+            reference* operator-> () {
+                return &ref;
+            }
+        };
+
+        const_iterator() = default;
+
+        reference operator* () const {
+            return reference{key(), value()};
+        }
+
+        pointer operator-> () const {
+            return pointer{**this};
+        }
+
+        const key_type& key() const;
+
+        const mapped_type& value() const {
+            return *frames.back().visited_node->value;
+        }
+
+        const const_iterator& operator++ () {
+            advance();
+            return *this;
+        }
+
+        const_iterator operator++ (int) {
+            const_iterator previous = *this;
+            advance();
+            return previous;
+        }
+
+        bool operator== (const const_iterator& other) const {
+            return frames.empty() ? other.frames.empty()
+                                  : !other.frames.empty() && frames.back().visited_node == other.frames.back().visited_node;
+        }
+
+        bool operator!= (const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        struct frame {
+            const node* visited_node;
+            size_type next_child;
+        };
+
+        std::vector<frame> frames{};            // path from the start node down to the current one
+        label_type key_units{};                 // key of the current node
+        mutable key_type cached_key{};
+        mutable bool key_cached{false};
+
+        const_iterator(const node* start_node, label_type start_key);
+        void advance();
+    };
+
+    /**
+     * Immutable handle on one version of a persistent_radix_tree, see persistent_radix_tree::snapshot().
+     */
+    template <typename Key, typename T, typename Split, typename Len>
+    class persistent_radix_tree<Key, T, Split, Len>::snapshot_type {
+        friend class persistent_radix_tree;
+
+    public:
+        snapshot_type() = default;
+        snapshot_type(const snapshot_type& other) noexcept
+                : root_node{retain(other.root_node)}, snapshot_size{other.snapshot_size} {}
+        snapshot_type(snapshot_type&& other) noexcept
+                : root_node{std::exchange(other.root_node, nullptr)}, snapshot_size{std::exchange(other.snapshot_size, 0)} {}
+        snapshot_type& operator= (snapshot_type other) noexcept {
+            std::swap(root_node, other.root_node);
+            std::swap(snapshot_size, other.snapshot_size);
+            return *this;
+        }
+        ~snapshot_type() {
+            release(root_node);
+        }
+
+        const mapped_type* find(key_view_type key) const noexcept {
+            const node* found_node = find_node(root_node, key);
+            return found_node != nullptr ? found_node->value.get() : nullptr;
+        }
+
+        const_iterator begin() const {
+            return const_iterator{root_node, label_type{}};
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator{};
+        }
+
+        range find_with_prefix(key_view_type prefix) const {
+            label_type path_key;
+            const node* prefix_node = find_prefix_node(root_node, prefix, path_key);
+            return range{const_iterator{prefix_node, std::move(path_key)}, end()};
+        }
+
+        size_type size() const noexcept {
+            return snapshot_size;
+        }
+
+        bool empty() const noexcept {
+            return snapshot_size == 0;
+        }
+
+    private:
+        snapshot_type(node* root_node, const size_type snapshot_size) noexcept
+                : root_node{retain(root_node)}, snapshot_size{snapshot_size} {}
+
+        node* root_node{nullptr};
+        size_type snapshot_size{0};
+    };
+
+    template <typename Key, typename T, typename Split, typename Len>
+    persistent_radix_tree<Key, T, Split, Len>::const_iterator::const_iterator(const node* start_node, label_type start_key) {
+        // first value in the subtree of start_node, whose key is start_key
+        if (start_node == nullptr) {
+            return;
+        }
+
+        frames.push_back(frame{start_node, 0});
+        key_units = std::move(start_key);
+        if (!start_node->value) {
+            advance();
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    const typename persistent_radix_tree<Key, T, Split, Len>::key_type& persistent_radix_tree<Key, T, Split, Len>::const_iterator::key() const {
+        if (!key_cached) {
+            cached_key = key_type{key_view_type(key_units.data(), key_units.size())};
+            key_cached = true;
+        }
+        return cached_key;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    void persistent_radix_tree<Key, T, Split, Len>::const_iterator::advance() {
+        // pre-order: a node's value comes before its children, children in unit order
+        key_cached = false;
+        while (!frames.empty()) {
+            frame& top = frames.back();
+            if (top.next_child < top.visited_node->children.size()) {
+                const node* child_node = top.visited_node->children[top.next_child++];
+                frames.push_back(frame{child_node, 0});
+                key_units += child_node->label;
+                if (child_node->value) {
+                    return;
+                }
+            } else {
+                if (frames.size() > 1) {
+                    key_units.resize(key_units.size() - top.visited_node->label.size());
+                }
+                frames.pop_back();
+            }
+        }
+        key_units.clear();
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    void persistent_radix_tree<Key, T, Split, Len>::release(node* released_node) noexcept {
+        /**
+         * Drops one reference and frees what nobody references any more, without recursion: a long chain of nodes
+         * must not overflow the stack. Nobody reads the count of a node being freed, so it holds the node being freed
+         * above it, to go back to once its children are done.
+         */
+        if (released_node == nullptr || !unreference(released_node)) {
+            return;
+        }
+
+        node* current_node = released_node;
+        current_node->reference_count.store(0, std::memory_order_relaxed);
+        while (current_node != nullptr) {
+            if (!current_node->children.empty()) {
+                node* child_node = current_node->children.back();
+                current_node->children.pop_back();
+                if (unreference(child_node)) {
+                    child_node->reference_count.store(reinterpret_cast<std::uintptr_t>(current_node), std::memory_order_relaxed);
+                    current_node = child_node;
+                }
+            } else {
+                node* back_node = reinterpret_cast<node*>(current_node->reference_count.load(std::memory_order_relaxed));
+                delete current_node;
+                current_node = back_node;
+            }
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename persistent_radix_tree<Key, T, Split, Len>::node* persistent_radix_tree<Key, T, Split, Len>::copy_node(const node* source_node) {
+        // the copy references the children and the value of source_node, which keeps them as well
+        std::unique_ptr<node> copied_node{new node{}};
+        copied_node->label = source_node->label;
+        copied_node->value = source_node->value;
+        copied_node->children = source_node->children;
+        for (node* child_node : copied_node->children) {
+            retain(child_node);
+        }
+        return copied_node.release();
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename persistent_radix_tree<Key, T, Split, Len>::node* persistent_radix_tree<Key, T, Split, Len>::own(node*& slot) {
+        /**
+         * The node in slot, made private to the current version. The descent owns every node above slot, so a node
+         * referenced once is only referenced from there and is changed in place; a shared node is replaced by a
+         * copy. Other threads can only drop a count to 1, never raise it from 1: snapshots are taken on the
+         * writer's side.
+         */
+        if (slot->reference_count.load(std::memory_order_acquire) == 1) {
+            return slot;
+        }
+
+        node* shared_node = slot;
+        slot = copy_node(shared_node);
+        release(shared_node);
+        return slot;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    const typename persistent_radix_tree<Key, T, Split, Len>::node* persistent_radix_tree<Key, T, Split, Len>::find_node(const node* start_node, key_view_type key) noexcept {
+        // node whose key is key, whether it has a value or not
+        size_type key_len = key_length(key);
+        size_type depth = 0;
+        const node* current_node = start_node;
+        while (current_node != nullptr && depth < key_len) {
+            unit_type unit = key_unit(key, depth);
+            auto position = child_position(current_node, unit);
+            if (position == current_node->children.end() || (*position)->get_search_unit() != unit) {
+                return nullptr;
+            }
+
+            const node* child_node = *position;
+            size_type label_len = child_node->label.size();
+            if (label_len > key_len - depth || sub_key(key, depth, label_len) != child_node->get_search_key()) {
+                return nullptr;
+            }
+            depth += label_len;
+            current_node = child_node;
+        }
+        return current_node;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    const typename persistent_radix_tree<Key, T, Split, Len>::node* persistent_radix_tree<Key, T, Split, Len>::find_prefix_node(const node* start_node, key_view_type prefix, label_type& path_key) {
+        // highest node whose key starts with prefix, path_key gets the key of that node
+        size_type prefix_len = key_length(prefix);
+        size_type depth = 0;
+        const node* current_node = start_node;
+        while (current_node != nullptr && depth < prefix_len) {
+            unit_type unit = key_unit(prefix, depth);
+            auto position = child_position(current_node, unit);
+            if (position == current_node->children.end() || (*position)->get_search_unit() != unit) {
+                return nullptr;
+            }
+
+            const node* child_node = *position;
+            size_type match_len = std::min(child_node->label.size(), prefix_len - depth);
+            if (sub_key(child_node->get_search_key(), 0, match_len) != sub_key(prefix, depth, match_len)) {
+                return nullptr;
+            }
+            path_key += child_node->label;
+            depth += match_len;
+            current_node = child_node;
+        }
+        return current_node;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    const typename persistent_radix_tree<Key, T, Split, Len>::mapped_type* persistent_radix_tree<Key, T, Split, Len>::find(key_view_type key) const noexcept {
+        const node* found_node = find_node(root_node, key);
+        return found_node != nullptr ? found_node->value.get() : nullptr;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    bool persistent_radix_tree<Key, T, Split, Len>::insert(const value_type& value) {
+        // like radix_tree::insert, an existing value is kept, and then nothing is copied
+        if (find(value.first) != nullptr) {
+            return false;
+        }
+        return put(value.first, std::make_shared<const mapped_type>(value.second));
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    bool persistent_radix_tree<Key, T, Split, Len>::insert(value_type&& value) {
+        if (find(value.first) != nullptr) {
+            return false;
+        }
+        return put(value.first, std::make_shared<const mapped_type>(std::move(value.second)));
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    template <typename M>
+    bool persistent_radix_tree<Key, T, Split, Len>::insert_or_assign(key_view_type key, M&& obj) {
+        // true if key was inserted, false if its value was replaced; snapshots keep the value they had
+        return put(key, std::make_shared<const mapped_type>(std::forward<M>(obj)));
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    bool persistent_radix_tree<Key, T, Split, Len>::put(key_view_type key, std::shared_ptr<const mapped_type> value) {
+        /**
+         * Sets the value of key, owning every node on the way down. A split allocates everything it needs before
+         * linking anything, so if an allocation throws the tree still holds the same keys.
+         *
+         * Current keys : (abc), insert (abd), "abc" is shared with a snapshot
+         *
+         * (root')                   the root is copied, "abc" is copied to "c" then linked below the new "ab"
+         *   |____ (ab)
+         *           |____ (c)
+         *           |____ (d)
+         */
+        if (root_node == nullptr) {
+            root_node = new node{};
+        }
+
+        size_type key_len = key_length(key);
+        size_type depth = 0;
+        node* current_node = own(root_node);
+        while (depth < key_len) {
+            unit_type unit = key_unit(key, depth);
+            auto position = child_position(current_node, unit);
+            key_view_type rest = sub_key(key, depth);
+            if (position == current_node->children.end() || (*position)->get_search_unit() != unit) {
+                std::unique_ptr<node> leaf_node{new node{}};
+                leaf_node->label.assign(rest.data(), key_len - depth);
+                leaf_node->value = std::move(value);
+                current_node->children.insert(position, leaf_node.get());
+                leaf_node.release();
+                ++tree_size;
+                return true;
+            }
+
+            size_type i = common_prefix_length((*position)->get_search_key(), rest);
+            if (i < (*position)->label.size()) {
+                std::unique_ptr<node> split_node{new node{}};
+                split_node->label.assign((*position)->label, 0, i);
+                split_node->children.reserve(2);
+                std::unique_ptr<node> leaf_node;
+                if (i < key_len - depth) {
+                    leaf_node.reset(new node{});
+                    leaf_node->label.assign(rest.data() + i, key_len - depth - i);
+                    leaf_node->value = std::move(value);
+                } else {
+                    split_node->value = std::move(value);
+                }
+
+                node* tail_node = own(*position);
+                tail_node->label.erase(0, i);
+                split_node->children.push_back(tail_node);
+                if (leaf_node) {
+                    auto leaf_position = leaf_node->get_search_unit() < tail_node->get_search_unit() ? split_node->children.begin()
+                                                                                                     : split_node->children.end();
+                    split_node->children.insert(leaf_position, leaf_node.release());
+                }
+                *position = split_node.release();
+                ++tree_size;
+                return true;
+            }
+
+            current_node = own(*position);
+            depth += i;
+        }
+
+        bool inserted = !current_node->value;
+        current_node->value = std::move(value);
+        tree_size += inserted ? 1 : 0;
+        return inserted;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename persistent_radix_tree<Key, T, Split, Len>::size_type persistent_radix_tree<Key, T, Split, Len>::erase(key_view_type key) {
+        /**
+         * Drops the value of key from the current version, copying the path down to it, and merges the nodes left
+         * with a single child and no value like radix_tree::erase does. Nothing is copied if key is missing.
+         */
+        const node* found_node = find_node(root_node, key);
+        if (found_node == nullptr || !found_node->value) {
+            return 0;
+        }
+
+        size_type key_len = key_length(key);
+        size_type depth = 0;
+        std::vector<node*> path{own(root_node)};
+        while (depth < key_len) {
+            node*& slot = *child_position(path.back(), key_unit(key, depth));
+            depth += slot->label.size();
+            path.push_back(own(slot));
+        }
+
+        node* erased_node = path.back();
+        erased_node->value.reset();
+        --tree_size;
+        if (path.size() == 1) {
+            return 1;           // the empty key, the root node always stays
+        }
+
+        // if a merge throws, the tree keeps a node without value and a single child, which is fine for any query
+        node* parent_node = path[path.size() - 2];
+        if (erased_node->children.empty()) {
+            parent_node->children.erase(child_position(parent_node, erased_node->get_search_unit()));
+            release(erased_node);
+            if (path.size() > 2 && !parent_node->value && parent_node->children.size() == 1) {
+                merge_with_only_child(path[path.size() - 3], parent_node);
+            }
+        } else if (erased_node->children.size() == 1) {
+            merge_with_only_child(parent_node, erased_node);
+        }
+        return 1;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    void persistent_radix_tree<Key, T, Split, Len>::merge_with_only_child(node* parent_node, node* merged_node) {
+        // merged_node, owned and without value, is replaced below parent_node by its only child, with both labels
+        node* only_child = own(merged_node->children.front());
+        label_type label;
+        label.reserve(merged_node->label.size() + only_child->label.size());
+        label.append(merged_node->label).append(only_child->label);
+
+        only_child->label.swap(label);
+        merged_node->children.clear();
+        *child_position(parent_node, only_child->get_search_unit()) = only_child;
+        release(merged_node);
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    void persistent_radix_tree<Key, T, Split, Len>::clear() noexcept {
+        // snapshots keep their nodes
+        release(std::exchange(root_node, nullptr));
+        tree_size = 0;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    void persistent_radix_tree<Key, T, Split, Len>::swap(persistent_radix_tree& other) noexcept {
+        std::swap(root_node, other.root_node);
+        std::swap(tree_size, other.tree_size);
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    typename persistent_radix_tree<Key, T, Split, Len>::snapshot_type persistent_radix_tree<Key, T, Split, Len>::snapshot() const noexcept {
+        /**
+         * The current version, which the next insert or erase leaves unchanged:
+         *
+         *      auto version = tree.snapshot();             // writer
+         *      std::thread reader{[version] {              // readers, no lock
+         *          for (auto entry : version.find_with_prefix("config/")) { ... }
+         *      }};
+         *      tree.insert_or_assign("config/a", value);   // writer moves on, version does not see it
+         */
+        return snapshot_type{root_node, tree_size};
+    }
+}
+
+#endif //PHAM_PHI_LONG_PERSISTENT_RADIX_TREE_H
@@ -6,6 +6,17 @@
 #define PHAM_PHI_LONG_RADIX_TREE_H
 
 #include "radix_tree_iterator.h"
+#include "radix_tree_stats.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <queue>
+#include <string>
+#include <memory>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace phamphilong {
@@ -13,13 +24,20 @@ namespace phamphilong {
      * Read:
      *      https://en.wikipedia.org/wiki/Radix_tree
      * for the definition.
+     *
+     * Keys are ordered lexicographically by their units compared as unsigned bytes (the order of std::string),
+     * iteration and the bound queries follow that order.
      */
     template <
             typename Key,
             typename T,
             typename Split = split<Key>,
-            typename Len = radix_len<Key>>
-    class radix_tree {
+            typename Len = radix_len<Key>,
+            typename Allocator = std::allocator<std::pair<const Key, T>>>
+    class radix_tree : private radix_tree_event_counters<T> {
+        friend class frozen_radix_tree<Key, T, Split, Len>;
+        friend struct radix_tree_parallel;
+
     public:
         using mapped_type = T;
         using key_type = Key;
@@ -27,203 +45,1127 @@ namespace phamphilong {
         using node_type = radix_tree_node<key_type , mapped_type , Split, Len>;
         using value_type = std::pair<const key_type , mapped_type>;
         using size_type = std::size_t;
+        using allocator_type = Allocator;
+        using key_view_type = typename Split::view_type;
+        using unit_type = typename node_type::unit_type;
+        using range = radix_tree_range<iterator>;
+        using fuzzy_match = radix_tree_fuzzy_match<iterator>;
+
+        static constexpr size_type no_limit = std::numeric_limits<size_type>::max();
+
+        radix_tree() = default;
+        explicit radix_tree(const allocator_type& allocator) : allocator{allocator} {}
+        template <typename InputIt>
+        radix_tree(InputIt first, InputIt last, const allocator_type& allocator = allocator_type{}) : allocator{allocator} {
+            assign(first, last);
+        }
+        radix_tree(const radix_tree&) = delete;
+        radix_tree& operator= (const radix_tree&) = delete;
+        ~radix_tree() {
+            clear();
+        }
+
+        template <typename InputIt> void assign(InputIt first, InputIt last);
+        void assign(std::istream& sorted_keys, const mapped_type& value = mapped_type{});
 
         iterator begin() const noexcept;
         iterator end() const noexcept;
-        iterator find(const key_type& key) const noexcept;
-        std::vector<iterator> find_with_prefix(const key_type& key) const noexcept;
+        iterator find(key_view_type key) const noexcept;
+        template <typename ForwardIt, typename OutputIt> OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt results) const;
+        range find_with_prefix(key_view_type prefix, const size_type limit = no_limit) const noexcept;
+        iterator lower_bound(key_view_type key) const noexcept;
+        iterator upper_bound(key_view_type key) const noexcept;
+        std::pair<iterator, iterator> equal_range(key_view_type key) const noexcept;
+        range find_range(key_view_type from, key_view_type to, const size_type limit = no_limit) const noexcept;
+        iterator longest_prefix_match(key_view_type key) const noexcept;
+        std::vector<fuzzy_match> find_fuzzy(key_view_type key, const size_type max_distance, const size_type limit = no_limit) const;
+        size_type count_with_prefix(key_view_type prefix) const;
+        size_type rank(key_view_type key) const;
+        iterator select(size_type n) const;
+        std::vector<iterator> top_k_with_prefix(key_view_type prefix, const size_type k) const;
         std::pair<iterator, bool> insert(const value_type& value);
-        size_type erase(const key_type& key);
+        std::pair<iterator, bool> insert(value_type&& value);
+        iterator insert(const iterator& hint, const value_type& value);
+        iterator insert(const iterator& hint, value_type&& value);
+        template <typename... Args> std::pair<iterator, bool> emplace(Args&&... args);
+        template <typename... Args> std::pair<iterator, bool> try_emplace(key_view_type key, Args&&... args);
+        template <typename M> std::pair<iterator, bool> insert_or_assign(key_view_type key, M&& obj);
+        void refresh_score(const iterator& position);
+        size_type erase(key_view_type key);
         size_type size() const noexcept;
         void clear() noexcept;
+        void compact();
+        void compact_into(radix_tree& target) const;
+        void swap(radix_tree& other) noexcept;
+        radix_tree_stats stats() const;
+
+        void shrink_to_fit() {
+            // same as compact(), under the name the standard containers use
+            compact();
+        }
+
+        radix_tree_counters counters() const noexcept {
+            // all zero unless there is a radix_count_events<T> specialization
+            return event_counters().snapshot();
+        }
+
+        void reset_counters() noexcept {
+            event_counters().reset();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator;
+        }
 
     private:
+        using alloc_traits = std::allocator_traits<allocator_type>;
+        using node_allocator_type = typename alloc_traits::template rebind_alloc<node_type>;
+        using node_alloc_traits = typename alloc_traits::template rebind_traits<node_type>;
+        using value_allocator_type = typename alloc_traits::template rebind_alloc<mapped_type>;
+        using value_alloc_traits = typename alloc_traits::template rebind_traits<mapped_type>;
+        using char_type = typename node_type::char_type;
+        using label_allocator_type = typename alloc_traits::template rebind_alloc<char_type>;
+        using label_alloc_traits = typename alloc_traits::template rebind_traits<char_type>;
+
+        allocator_type allocator{};
         node_type* root_node{nullptr};
         size_type tree_size{};
         const Split split_key{};
         const Len get_key_len{};
 
-        iterator find_node(const key_type& key, const size_type cur_key_depth, node_type* traverse_node) const {
-            if (traverse_node == nullptr) {
-                return end();
+        const radix_tree_event_counters<T>& event_counters() const noexcept {
+            // the empty base unless counters are enabled
+            return *this;
+        }
+
+        static unit_type key_unit(key_view_type key, const size_type pos) {
+            return static_cast<unit_type>(key[pos]);
+        }
+
+        bool match_label(key_view_type key, const size_type cur_key_depth, const node_type* child_node) const {
+            // true if the edge label of child node is a prefix of key[cur_key_depth..]
+            key_view_type label = child_node->get_search_key();
+            size_type label_len = get_key_len(label);
+            return label_len <= get_key_len(key) - cur_key_depth && split_key(key, cur_key_depth, label_len) == label;
+        }
+
+        iterator find_node(key_view_type key, size_type cur_key_depth, node_type* traverse_node) const {
+            // a loop rather than recursion, so that the stack does not grow with the key length
+            size_type key_len = get_key_len(key);
+            while (traverse_node != nullptr) {
+                event_counters().count_lookup_step();
+                if (cur_key_depth == key_len) {
+                    return traverse_node->has_value() ? iterator{traverse_node} : end();
+                }
+
+                node_type* child_node = traverse_node->children.find(key_unit(key, cur_key_depth));
+                if (child_node == nullptr || !match_label(key, cur_key_depth, child_node)) {
+                    return end();       // cannot find
+                }
+
+                cur_key_depth += child_node->label_len;
+                traverse_node = child_node;
+            }
+            return end();
+        }
+
+        node_type* hint_start_node(const iterator& hint, key_view_type key) {
+            /**
+             * Deepest node on the path of hint whose key is a prefix of key, the descent of an insert can start there
+             * instead of at the root. With l the common prefix length of key and the key of hint, which the iterator
+             * caches, that is the deepest ancestor of hint no deeper than l: no label on the path is compared.
+             *
+             * hint (abcd), key (abx), l = 2
+             *
+             * (root)
+             *   |____ (ab)             <- start node
+             *           |____ (cd)     <- hint
+             */
+            if (hint.pointed_node == nullptr) {
+                return get_root_node();
+            }
+
+            size_type common_len = common_prefix_length(hint.key(), key);
+            node_type* start_node = hint.pointed_node;
+            while (start_node->depth > common_len) {
+                start_node = start_node->parent_node;
             }
+            return start_node;
+        }
 
-            if (traverse_node->is_leaf()) {
-                if (cur_key_depth == get_key_len(key) && traverse_node->value->first == key) {
-                    return iterator{traverse_node};
+        node_type* get_root_node() {
+            if (!root_node) {
+                root_node = create_node(
+                        key_view_type{},                                // label
+                        nullptr,                                        // parent_node
+                        static_cast<size_type >(0));                    // depth
+            }
+            return root_node;
+        }
+
+        node_type* find_prefix_node(key_view_type prefix) const noexcept {
+            // return the highest node whose key starts with prefix, all keys with that prefix are in its subtree
+            size_type prefix_len = get_key_len(prefix);
+            size_type cur_key_depth = 0;
+            node_type* traverse_node = root_node;
+
+            while (traverse_node != nullptr && cur_key_depth < prefix_len) {
+                node_type* child_node = traverse_node->children.find(key_unit(prefix, cur_key_depth));
+                if (child_node == nullptr) {
+                    return nullptr;
+                }
+
+                key_view_type label = child_node->get_search_key();
+                size_type match_len = std::min(get_key_len(label), prefix_len - cur_key_depth);
+                if (split_key(label, 0, match_len) != split_key(prefix, cur_key_depth, match_len)) {
+                    return nullptr;
+                }
+
+                cur_key_depth += match_len;
+                traverse_node = child_node;
+            }
+
+            return traverse_node;
+        }
+
+        /**
+         * With a radix_subtree_count<T> specialization every node counts the values in its subtree, kept up to date
+         * on the way back from each insert and erase, so count_with_prefix(), rank() and select() only look at the
+         * nodes along one key. Otherwise the helpers below that keep the counts compile to nothing.
+         */
+        static constexpr bool counted = radix_tree_node_count<T>::enabled;
+
+        static void add_subtree_count(node_type* node, const size_type count) noexcept {
+            // node and all its ancestors gain count values
+            if constexpr (counted) {
+                for (; node != nullptr; node = node->parent_node) {
+                    node->subtree_count += count;
                 }
             } else {
-                for (auto &child_node : traverse_node->children) {
-                    size_type child_key_len = get_key_len(child_node.first);
-                    key_type sub_key = split_key(key, cur_key_depth, child_key_len);
-
-                    if (child_key_len > 0 && child_node.first == sub_key) {
-                        size_type new_key_depth = cur_key_depth + child_key_len;
-                        return find_node(key, new_key_depth, child_node.second);
-                    } else if (child_key_len == 0 && child_node.second->is_leaf() && child_node.second->depth == get_key_len(key) && child_node.second->value->first == key) {
-                        return iterator{child_node.second};
+                (void) node;
+                (void) count;
+            }
+        }
+
+        static void subtract_subtree_count(node_type* node, const size_type count) noexcept {
+            if constexpr (counted) {
+                for (; node != nullptr; node = node->parent_node) {
+                    node->subtree_count -= count;
+                }
+            } else {
+                (void) node;
+                (void) count;
+            }
+        }
+
+        static void copy_subtree_count(node_type* target_node, const node_type* source_node) noexcept {
+            // target_node takes over the subtree source_node had, or a copy of it
+            if constexpr (counted) {
+                target_node->subtree_count = source_node->subtree_count;
+            } else {
+                (void) target_node;
+                (void) source_node;
+            }
+        }
+
+        static void attach_subtree_count(node_type* parent_node, const node_type* child_node) noexcept {
+            // child_node with its subtree was just linked below parent_node
+            if constexpr (counted) {
+                add_subtree_count(parent_node, child_node->subtree_count);
+            } else {
+                (void) parent_node;
+                (void) child_node;
+            }
+        }
+
+        static size_type subtree_count(const node_type* node) noexcept {
+            return node->subtree_count;
+        }
+
+        /**
+         * With a radix_score<T> specialization every node caches the highest score in its subtree. Each change of a
+         * value refreshes the cache from that node up, and stops at the first ancestor whose maximum stays the same.
+         */
+        static constexpr bool scored = radix_tree_node_score<T>::enabled;
+
+        static void refresh_max_score(node_type* node) {
+            if constexpr (scored) {
+                using score_type = typename radix_score<T>::score_type;
+                for (bool first = true; node != nullptr; node = node->parent_node, first = false) {
+                    score_type max_score = node->has_value() ? radix_score<T>::get(*node->value)
+                                                             : std::numeric_limits<score_type>::lowest();
+                    node->children.for_each([&max_score](unit_type, const node_type* child_node) {
+                        max_score = std::max(max_score, child_node->max_score);
+                    });
+                    if (!first && max_score == node->max_score) {
+                        break;
                     }
+                    node->max_score = max_score;
                 }
+            } else {
+                (void) node;
             }
+        }
 
-            return end();       // cannot find
+        static void raise_max_score(node_type* node, const node_type* source_node) noexcept {
+            // node and its ancestors take the subtree of source_node into account, e.g. once it is linked below node
+            if constexpr (scored) {
+                for (; node != nullptr && node->max_score < source_node->max_score; node = node->parent_node) {
+                    node->max_score = source_node->max_score;
+                }
+            } else {
+                (void) node;
+                (void) source_node;
+            }
         }
 
-        iterator find_parent_node(const key_type& key, const size_type cur_key_depth, node_type* parent_node) const {
-            if (parent_node == nullptr) {
-                return end();
+        static node_type* first_value_node(node_type* node) noexcept {
+            // every node without a value has children, so the leftmost path always reaches a value
+            while (!node->has_value()) {
+                node = node->children.first();
             }
+            return node;
+        }
 
-            for (auto &child_node : parent_node->children) {
-                size_type child_key_len = get_key_len(child_node.first);
-                key_type sub_key = split_key(key, cur_key_depth, child_key_len);
+        static node_type* next_subtree_value_node(node_type* node) noexcept {
+            // first node with a value after the whole subtree of node, in key order
+            for (node_type* parent_node = node->parent_node; parent_node != nullptr; parent_node = node->parent_node) {
+                node_type* sibling_node = parent_node->children.next(node->get_search_unit());
+                if (sibling_node != nullptr) {
+                    return first_value_node(sibling_node);
+                }
+                node = parent_node;
+            }
+            return nullptr;
+        }
 
-                if (child_key_len > 0 && child_node.first == sub_key) {      // matched path
-                    size_type new_key_depth = cur_key_depth + child_key_len;
-                    return find_parent_node(key, new_key_depth, child_node.second);
+        static iterator limit_range(iterator first, const iterator& last, const size_type limit) noexcept {
+            // end of [first, last) after at most `limit` entries
+            if (limit != no_limit) {
+                for (size_type count = 0; count < limit && first != last; ++count) {
+                    ++first;
                 }
+                return first;
             }
+            return last;
+        }
 
-            return parent_node;
+        size_type common_prefix_length(key_view_type lhs, key_view_type rhs) const noexcept {
+            size_type max_len = std::min(get_key_len(lhs), get_key_len(rhs));
+            size_type i = 0;
+            // skip equal 8 unit words, the mismatching word is finished unit by unit below
+            for (; i + sizeof(std::uint64_t) <= max_len; i += sizeof(std::uint64_t)) {
+                std::uint64_t lhs_word, rhs_word;
+                std::memcpy(&lhs_word, lhs.data() + i, sizeof(lhs_word));
+                std::memcpy(&rhs_word, rhs.data() + i, sizeof(rhs_word));
+                if (lhs_word != rhs_word) {
+                    break;
+                }
+            }
+            for (; i < max_len && lhs[i] == rhs[i]; ++i) {}
+            return i;
         }
+
+        bool key_less(key_view_type lhs, key_view_type rhs) const noexcept {
+            size_type lhs_len = get_key_len(lhs);
+            size_type rhs_len = get_key_len(rhs);
+            for (size_type i = 0; i < lhs_len && i < rhs_len; ++i) {
+                if (key_unit(lhs, i) != key_unit(rhs, i)) {
+                    return key_unit(lhs, i) < key_unit(rhs, i);
+                }
+            }
+            return lhs_len < rhs_len;
+        }
+
+        class bulk_loader;
+
+        static constexpr size_type batch_group_size = 16;     // lookups find_batch keeps in flight
+
+        node_type* lower_bound_node(key_view_type key, bool& exact_match) const noexcept;
+        node_type* merge_with_only_child(node_type* node, node_type* only_child);
+        template <typename... Args> std::pair<iterator, bool> emplace_below(node_type* start_node, key_view_type key, Args&&... args);
+
+        node_type* create_node(key_view_type label, node_type* parent_node, const size_type depth) {
+            node_allocator_type node_allocator(allocator);
+            node_type* node = node_alloc_traits::allocate(node_allocator, 1);
+            ::new (static_cast<void*>(node)) node_type(parent_node, depth);
+            try {
+                assign_label(node, label);
+            } catch (...) {
+                node_alloc_traits::deallocate(node_allocator, node, 1);
+                throw;
+            }
+            return node;
+        }
+
+        void destroy_node(node_type* node) noexcept {
+            node->children.clear(allocator);
+            destroy_value(node->value);
+            free_label(node->label_len > node_type::inline_label_capacity ? node->heap_label : nullptr, node->label_len);
+            node_allocator_type node_allocator(allocator);
+            node_alloc_traits::deallocate(node_allocator, node, 1);
+        }
+
+        void assign_label(node_type* node, key_view_type prefix, key_view_type suffix = key_view_type{}) {
+            // set the edge label of node to prefix + suffix, both may point into the current label of node
+            size_type prefix_len = get_key_len(prefix);
+            size_type label_len = prefix_len + get_key_len(suffix);
+            char_type* old_heap_label = node->has_inline_label() ? nullptr : node->heap_label;
+            size_type old_label_len = node->label_len;
+
+            if (label_len <= node_type::inline_label_capacity) {
+                char_type units[node_type::inline_label_capacity]{};
+                std::copy(prefix.data(), prefix.data() + prefix_len, units);
+                std::copy(suffix.data(), suffix.data() + (label_len - prefix_len), units + prefix_len);
+                std::copy(units, units + label_len, node->inline_label);
+            } else {
+                label_allocator_type label_allocator(allocator);
+                char_type* units = label_alloc_traits::allocate(label_allocator, label_len);
+                std::copy(prefix.data(), prefix.data() + prefix_len, units);
+                std::copy(suffix.data(), suffix.data() + (label_len - prefix_len), units + prefix_len);
+                node->heap_label = units;
+            }
+
+            node->label_len = static_cast<std::uint32_t>(label_len);
+            free_label(old_heap_label, old_label_len);
+        }
+
+        void free_label(char_type* heap_label, const size_type label_len) noexcept {
+            if (heap_label != nullptr) {
+                label_allocator_type label_allocator(allocator);
+                label_alloc_traits::deallocate(label_allocator, heap_label, label_len);
+            }
+        }
+
+        template <typename... Args>
+        mapped_type* create_value(Args&&... args) {
+            value_allocator_type value_allocator(allocator);
+            mapped_type* new_value = value_alloc_traits::allocate(value_allocator, 1);
+            try {
+                value_alloc_traits::construct(value_allocator, new_value, std::forward<Args>(args)...);
+            } catch (...) {
+                value_alloc_traits::deallocate(value_allocator, new_value, 1);
+                throw;
+            }
+            return new_value;
+        }
+
+        void destroy_value(mapped_type* value) noexcept {
+            if (value != nullptr) {
+                value_allocator_type value_allocator(allocator);
+                value_alloc_traits::destroy(value_allocator, value);
+                value_alloc_traits::deallocate(value_allocator, value, 1);
+            }
+        }
+
+        struct value_deleter {
+            radix_tree* tree;
+
+            void operator()(mapped_type* value) const noexcept {
+                tree->destroy_value(value);
+            }
+        };
+
+        // owns a value until it is stored in its node
+        using value_holder = std::unique_ptr<mapped_type, value_deleter>;
+
+        void destroy_subtree(node_type* subtree_node) noexcept {
+            // post-order along the parent links, no recursion: a node is freed once its last child is, the children
+            // table of the parent is only read for the next sibling
+            node_type* node = subtree_node;
+            for (;;) {
+                while (!node->is_leaf()) {
+                    node = node->children.first();
+                }
+
+                for (;;) {
+                    if (node == subtree_node) {
+                        destroy_node(node);
+                        return;
+                    }
+
+                    node_type* parent_node = node->parent_node;
+                    unit_type unit = node->get_search_unit();
+                    destroy_node(node);
+                    node = parent_node->children.next(unit);
+                    if (node != nullptr) {
+                        break;
+                    }
+                    node = parent_node;
+                }
+            }
+        }
+
+        template <typename A>
+        static auto release_allocator(A& allocator, int) noexcept -> decltype(static_cast<bool>(allocator.release())) {
+            return allocator.release();
+        }
+
+        template <typename A>
+        static bool release_allocator(A&, long) noexcept {
+            return false;
+        }
+
+        template <typename A>
+        static auto compaction_allocator(const A& allocator, int) -> decltype(allocator.get_pool().use_count(), A{}) {
+            // the free blocks of a pool are scattered, a pool nobody else uses is traded for a fresh one
+            return allocator.get_pool().use_count() == 1 ? A{} : allocator;
+        }
+
+        template <typename A>
+        static A compaction_allocator(const A& allocator, long) {
+            return allocator;
+        }
+
+        struct relocation {
+            node_type* node;
+            mapped_type* storage;           // allocated, not constructed yet
+            mapped_type* value;
+        };
+
+        void copy_from(const radix_tree& source, std::vector<relocation>* relocations);
     };
 
-    template <typename Key, typename T, typename Split, typename Len>
-    inline typename radix_tree<Key, T, Split, Len>::iterator radix_tree<Key, T, Split, Len>::begin() const noexcept {
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    inline typename radix_tree<Key, T, Split, Len, Allocator>::iterator radix_tree<Key, T, Split, Len, Allocator>::begin() const noexcept {
         if (root_node == nullptr) {
             return end();
         }
 
+        if (root_node->has_value()) {
+            // the empty key is stored in the root node
+            return iterator{root_node};
+        }
+
         return ++iterator{root_node};
     }
 
-    template <typename Key, typename T, typename Split, typename Len>
-    inline typename radix_tree<Key, T, Split, Len>::iterator radix_tree<Key, T, Split, Len>::end() const noexcept {
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    inline typename radix_tree<Key, T, Split, Len, Allocator>::iterator radix_tree<Key, T, Split, Len, Allocator>::end() const noexcept {
         return iterator{nullptr};
     }
 
-    template <typename Key, typename T, typename Split, typename Len>
-    typename radix_tree<Key, T, Split, Len>::iterator radix_tree<Key, T, Split, Len>::find(const key_type& key) const noexcept {
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::iterator radix_tree<Key, T, Split, Len, Allocator>::find(key_view_type key) const noexcept {
         if (!root_node) {
             // empty radix-tree
             return end();
         }
 
+        event_counters().count_lookup();
         return find_node(key, 0, root_node);
     }
 
-    template <typename Key, typename T, typename Split, typename Len>
-    std::vector<typename radix_tree<Key, T, Split, Len>::iterator> radix_tree<Key, T, Split, Len>::find_with_prefix(const key_type& key) const noexcept {
-        std::vector<typename radix_tree<Key, T, Split, Len>::iterator> matched_iterators{};
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    template <typename ForwardIt, typename OutputIt>
+    OutputIt radix_tree<Key, T, Split, Len, Allocator>::find_batch(ForwardIt first, ForwardIt last, OutputIt results) const {
+        /**
+         * Writes find(key) for every key of [first, last) to results, in order.
+         *
+         * One lookup stalls on a cache miss at every level: the node, its children table, the child. Here up to
+         * batch_group_size lookups advance in turns, each turn touches only memory prefetched by the previous turn of
+         * that lookup and prefetches what it needs next, so the misses of the whole group overlap:
+         *
+         *      turn      lookup 0            lookup 1            ...
+         *        1     prefetch table      prefetch table
+         *        2     prefetch child      prefetch child
+         *        3     match label,        match label,
+         *              prefetch table      prefetch table
+         *       ...
+         */
+        using children_type = typename node_type::children_type;
 
-        if (!root_node) {
+        struct lookup {
+            key_view_type key;
+            size_type key_len;
+            size_type depth;
+            node_type* node;
+            node_type* child_node;          // set while waiting for the child to be in cache
+        };
+
+        lookup lookups[batch_group_size];
+        iterator found[batch_group_size];
+        size_type in_flight[batch_group_size];
+
+        // at a node whose line is in cache: either done, or prefetch the children table entry of the next unit
+        auto enter_node = [this, &found](lookup& current, const size_type index) {
+            if (current.depth == current.key_len) {
+                found[index] = current.node->has_value() ? iterator{current.node} : end();
+                return false;
+            }
+            current.node->children.prefetch(key_unit(current.key, current.depth));
+            current.child_node = nullptr;
+            return true;
+        };
+
+        while (first != last) {
+            size_type group_size = 0;
+            for (; first != last && group_size < batch_group_size; ++first, ++group_size) {
+                lookup& current = lookups[group_size];
+                current.key = *first;
+                current.key_len = get_key_len(current.key);
+                current.depth = 0;
+                current.node = root_node;
+                found[group_size] = end();
+                children_type::prefetch_address(current.key.data());
+            }
+
+            size_type active = 0;
+            for (size_type i = 0; i < group_size && root_node != nullptr; ++i) {
+                if (enter_node(lookups[i], i)) {
+                    in_flight[active++] = i;
+                }
+            }
+
+            while (active > 0) {
+                for (size_type slot = 0; slot < active; ) {
+                    size_type index = in_flight[slot];
+                    lookup& current = lookups[index];
+                    bool running;
+                    if (current.child_node == nullptr) {
+                        // the table entry is in cache, look up the child and prefetch it
+                        current.child_node = current.node->children.find(key_unit(current.key, current.depth));
+                        running = current.child_node != nullptr;
+                        if (running) {
+                            children_type::prefetch_address(current.child_node);
+                        }
+                    } else {
+                        // the child is in cache, check its label and go on from it
+                        running = match_label(current.key, current.depth, current.child_node);
+                        if (running) {
+                            current.depth += current.child_node->label_len;
+                            current.node = current.child_node;
+                            running = enter_node(current, index);
+                        }
+                    }
+
+                    if (running) {
+                        ++slot;
+                    } else {
+                        in_flight[slot] = in_flight[--active];
+                    }
+                }
+            }
+
+            for (size_type i = 0; i < group_size; ++i) {
+                *results++ = std::move(found[i]);
+            }
+        }
+        return results;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::range radix_tree<Key, T, Split, Len, Allocator>::find_with_prefix(key_view_type prefix, const size_type limit) const noexcept {
+        /**
+         * Current keys : (abc), (abcef), (abd), (b)
+         *
+         * (root)
+         *   |____ (ab)
+         *   |       |____ (c)
+         *   |       |      |____ (ef)
+         *   |       |____ (d)
+         *   |____ (b)
+         *
+         * prefix (a) is covered by node (ab), the range starts at its leftmost value (abc) and stops at the first
+         * value after its subtree (b). Nothing is collected, the range is walked lazily by the caller.
+         */
+        if (!root_node || limit == 0) {
             // empty radix-tree
-            return matched_iterators;
+            return range{end(), end()};
+        }
+
+        node_type* prefix_node = find_prefix_node(prefix);
+        if (prefix_node == nullptr || (prefix_node->is_root() && prefix_node->is_leaf() && !prefix_node->has_value())) {
+            return range{end(), end()};
+        }
+
+        iterator first{first_value_node(prefix_node)};
+        iterator last{next_subtree_value_node(prefix_node)};
+
+        // stop early after `limit` entries, the range end is never further than the end of the subtree
+        return range{first, limit_range(first, last, limit)};
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::iterator radix_tree<Key, T, Split, Len, Allocator>::lower_bound(key_view_type key) const noexcept {
+        bool exact_match;
+        return iterator{lower_bound_node(key, exact_match)};
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::node_type* radix_tree<Key, T, Split, Len, Allocator>::lower_bound_node(key_view_type key, bool& exact_match) const noexcept {
+        /**
+         * Single descent along key, at the first node that leaves the path of key the answer is either in the
+         * subtree of that node (all its keys are greater) or right after it (all its keys are smaller):
+         *
+         * (root)
+         *   |____ (ab)
+         *           |____ (c)
+         *           |____ (f)
+         *
+         * lower_bound (abd) : (d) is missing below (ab), the next child (f) holds the answer (abf)
+         * lower_bound (aa)  : (ab) > (aa) at the second unit, the answer is the leftmost key below (ab)
+         * lower_bound (b)   : no child from (b) on, the answer is after the subtree of (root), i.e. end()
+         */
+        exact_match = false;
+        if (root_node == nullptr || (root_node->is_leaf() && !root_node->has_value())) {
+            return nullptr;
         }
 
+        size_type key_len = get_key_len(key);
+        size_type cur_key_depth = 0;
+        node_type* traverse_node = root_node;
+
+        for (;;) {
+            if (cur_key_depth == key_len) {
+                // every key below this node starts with key
+                exact_match = traverse_node->has_value();
+                return first_value_node(traverse_node);
+            }
 
+            unit_type unit = key_unit(key, cur_key_depth);
+            node_type* child_node = traverse_node->children.find(unit);
+            if (child_node == nullptr) {
+                node_type* next_node = traverse_node->children.next(unit);
+                return next_node != nullptr ? first_value_node(next_node) : next_subtree_value_node(traverse_node);
+            }
+
+            key_view_type label = child_node->get_search_key();
+            size_type label_len = get_key_len(label);
+            size_type i = 1;
+            for (; i < label_len && cur_key_depth + i < key_len && key_unit(label, i) == key_unit(key, cur_key_depth + i); ++i) {}
+
+            if (i == label_len) {
+                // matched path
+                cur_key_depth += label_len;
+                traverse_node = child_node;
+            } else if (cur_key_depth + i == key_len || key_unit(label, i) > key_unit(key, cur_key_depth + i)) {
+                // key ends inside the label or the label is greater, the whole subtree is not smaller than key
+                return first_value_node(child_node);
+            } else {
+                // the whole subtree is smaller than key
+                return next_subtree_value_node(child_node);
+            }
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::iterator radix_tree<Key, T, Split, Len, Allocator>::upper_bound(key_view_type key) const noexcept {
+        bool exact_match;
+        iterator it{lower_bound_node(key, exact_match)};
+        if (exact_match) {
+            ++it;
+        }
+        return it;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    std::pair<typename radix_tree<Key, T, Split, Len, Allocator>::iterator, typename radix_tree<Key, T, Split, Len, Allocator>::iterator> radix_tree<Key, T, Split, Len, Allocator>::equal_range(key_view_type key) const noexcept {
+        return std::make_pair(lower_bound(key), upper_bound(key));
     }
 
-    template <typename Key, typename T, typename Split, typename Len>
-    std::pair<typename radix_tree<Key, T, Split, Len>::iterator, bool> radix_tree<Key, T, Split, Len>::insert(const value_type& value) {
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::range radix_tree<Key, T, Split, Len, Allocator>::find_range(key_view_type from, key_view_type to, const size_type limit) const noexcept {
+        // keys in [from, to), at most `limit` of them
+        if (!key_less(from, to) || limit == 0) {
+            return range{end(), end()};
+        }
+
+        iterator first = lower_bound(from);
+        return range{first, limit_range(first, lower_bound(to), limit)};
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::iterator radix_tree<Key, T, Split, Len, Allocator>::longest_prefix_match(key_view_type key) const noexcept {
+        /**
+         * Longest stored key that is a prefix of key, i.e. the deepest node with a value met while descending along
+         * key.
+         *
+         * Current keys : (10), (10.1), (10.1.2.3)
+         *
+         *      longest_prefix_match("10.1.2.4") = 10.1
+         *      longest_prefix_match("10.2")     = 10
+         *      longest_prefix_match("11")       = end()
+         */
         if (!root_node) {
-            // add root node
-            //root_node = std::make_shared<node_type>(split_key(value.first, 0, 0), nullptr);
-            root_node = new node_type(
-                    std::make_pair(key_type{}, mapped_type{}),      // value
-                    nullptr,                                        // parent_node
-                    static_cast<size_type >(0));                    // depth
+            return end();
         }
 
-        auto parent_it = find_parent_node(value.first, 0, root_node);
-        if (parent_it == end()) {
-            return std::make_pair<iterator, bool>(std::move(parent_it), false);
+        size_type key_len = get_key_len(key);
+        node_type* traverse_node = root_node;
+        node_type* matched_node = root_node->has_value() ? root_node : nullptr;
+        for (size_type cur_key_depth = 0; cur_key_depth < key_len; ) {
+            node_type* child_node = traverse_node->children.find(key_unit(key, cur_key_depth));
+            if (child_node == nullptr || !match_label(key, cur_key_depth, child_node)) {
+                break;
+            }
+
+            cur_key_depth += child_node->label_len;
+            traverse_node = child_node;
+            if (traverse_node->has_value()) {
+                matched_node = traverse_node;
+            }
         }
 
-        bool found_common_branch{false};
-        key_type sub_key = split_key(value.first, parent_it.pointed_node->depth);
-        auto sub_key_len = get_key_len(sub_key);
+        return matched_node != nullptr ? iterator{matched_node} : end();
+    }
 
-        for (auto &child_node : parent_it.pointed_node->children) {
-            size_type child_key_len = get_key_len(child_node.first);
-            size_type i=0;
-            for (; (i < child_key_len) && (i < sub_key_len) && (child_node.first[i] == sub_key[i]); ++i) {
-                found_common_branch = true;
-            }
-
-            if (found_common_branch) {
-                /**
-                 * Current keys : (abc), (abcedf)
-                 *
-                 * (root)
-                 *   |____ (abc)
-                 *           |____ ()
-                 *           |____ (ef)
-                 *
-                 * insert key (abd)
-                 *
-                 * (root)
-                 *   |____ (ab)
-                 *           |____ (c)
-                 *           |      |____ ()
-                 *           |      |____ (ef)
-                 *           |____ (d)
-                 *
-                 *  parent_it = (root)
-                 *  found_node = (abc)
-                 *  new_node = (d)
-                 *  new_parent_node = (ab)
-                 *  common_branch = (root) ____ (abc)
-                 *
-                 *  Algorithm:
-                 *      (step 1) remove but not delete node (abc) from parent_it (root) children list
-                 *      (step 2) add new parent node (ab) to current parent node (root)
-                 *      (step 3) transform fond node (abc) to (c)
-                 *      (step 4) add found node (c) to the children list of new parent node (ab)
-                 *      (step 5) add new node (d) to (ab) children list
-                 *
-                 */
-
-                // (step 1) remove but not delete node (abc) from parent_it (root) children list
-                node_type* found_node = child_node.second;
-                parent_it.pointed_node->children.erase(child_node.first);
-
-                // (step 2) add new parent node (ab) to current parent node (root)
-                key_type new_parent_node_search_key = split_key(found_node->get_search_key(), 0, i);
-                key_type new_parent_node_key = split_key(found_node->value->first, 0, parent_it.pointed_node->depth + i);
-                auto new_parent_insert_result = parent_it.pointed_node->children.insert(std::pair<key_type, node_type*>(
-                        new_parent_node_search_key,
-                        new node_type{
-                                std::make_pair(new_parent_node_key, mapped_type{}),                // value
-                                parent_it.pointed_node,                                            // parent_node
-                                get_key_len(new_parent_node_key)                                   // depth
-                        }
-                ));
-                node_type* new_parent_node = new_parent_insert_result.first->second;
-
-                // (step 3) transform found node (abc) to (c)
-                found_node->parent_node = new_parent_node;
-
-                // (step 4) add found node (c) to the children list of new parent node (ab)
-                new_parent_node->children.insert(std::pair<key_type, node_type*>(found_node->get_search_key(), found_node));
-
-                // (step 5) add new node (d) to (ab) children list
-                key_type new_node_search_key = split_key(sub_key, i);
-                auto new_node_insert_result = new_parent_node->children.insert(std::pair<key_type, node_type*>(
-                        new_node_search_key,
-                        new node_type{
-                                value,                      // value
-                                new_parent_node,            // parent_node
-                                get_key_len(value.first)    // depth
-                        }
-                ));
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    std::vector<typename radix_tree<Key, T, Split, Len, Allocator>::fuzzy_match> radix_tree<Key, T, Split, Len, Allocator>::find_fuzzy(key_view_type key, const size_type max_distance, const size_type limit) const {
+        /**
+         * Entries whose key is at most max_distance edits (unit insertions, deletions or substitutions) away from
+         * key, by increasing distance, keys at the same distance in key order, at most limit of them.
+         *
+         * Every unit of an edge label adds one row of the Levenshtein table of key against the path, the row of a
+         * node is shared by all keys below it. Rows are kept per depth, a node only writes rows deeper than its
+         * parent, so depth first the rows of the path are always in place. A subtree is skipped once the smallest
+         * value of a row is over the bound: rows never decrease downwards.
+         *
+         * key (cat), max_distance 1
+         *
+         *          c  a  t
+         *       0  1  2  3
+         * (c)   1  0  1  2
+         * (a)   2  1  0  1
+         * (r)   3  2  1  1     <- (car) matches with distance 1
+         * (s)   4  3  2  2     <- (cars) and anything below is skipped
+         *
+         * Once limit matches are at distance d or less, the bound drops to d, so a small limit also prunes more.
+         */
+        std::vector<fuzzy_match> matches;
+        if (root_node == nullptr || limit == 0) {
+            return matches;
+        }
+
+        size_type key_len = get_key_len(key);
+        size_type row_len = key_len + 1;
+        size_type bound = max_distance;
+        std::vector<size_type> found_at(max_distance + 1);       // matches by distance
+        std::vector<size_type> rows(row_len);
+        for (size_type i = 0; i < row_len; ++i) {
+            rows[i] = i;
+        }
+
+        std::vector<node_type*> pending{root_node};
+        while (!pending.empty()) {
+            node_type* node = pending.back();
+            pending.pop_back();
 
-                tree_size++;
-                return std::pair<iterator, bool>(new_node_insert_result.first->second, true);
+            // rows of the units of the label of node, a node deeper than key_len + bound cannot match
+            size_type first_depth = node->depth - node->label_len;
+            size_type last_depth = std::min<size_type>(node->depth, key_len + bound + 1);
+            if (rows.size() < (last_depth + 1) * row_len) {
+                rows.resize((last_depth + 1) * row_len);
             }
+            size_type row_min = 0;
+            for (size_type depth = first_depth + 1; depth <= last_depth; ++depth) {
+                const size_type* above = &rows[(depth - 1) * row_len];
+                size_type* row = &rows[depth * row_len];
+                unit_type unit = static_cast<unit_type>(node->label_data()[depth - 1 - first_depth]);
+                row[0] = depth;
+                row_min = depth;
+                for (size_type i = 1; i < row_len; ++i) {
+                    size_type substitution = above[i - 1] + (key_unit(key, i - 1) == unit ? 0 : 1);
+                    row[i] = std::min(std::min(above[i], row[i - 1]) + 1, substitution);
+                    row_min = std::min(row_min, row[i]);
+                }
+                if (row_min > bound) {
+                    break;
+                }
+            }
+            if (row_min > bound || last_depth < node->depth) {
+                continue;
+            }
+
+            size_type distance = rows[node->depth * row_len + key_len];
+            if (node->has_value() && distance <= bound) {
+                matches.push_back(fuzzy_match{iterator{node}, distance});
+                found_at[distance]++;
+                // once limit matches are closer than bound, a match at bound cannot make it into the result
+                while (bound > 0) {
+                    size_type closer = 0;
+                    for (size_type d = 0; d < bound; ++d) {
+                        closer += found_at[d];
+                    }
+                    if (closer < limit) {
+                        break;
+                    }
+                    --bound;
+                }
+            }
+
+            // children pushed in reverse, so that they come off the stack in key order
+            size_type mark = pending.size();
+            node->children.for_each([&pending](unit_type, node_type* child_node) {
+                pending.push_back(child_node);
+            });
+            std::reverse(pending.begin() + static_cast<std::ptrdiff_t>(mark), pending.end());
+        }
+
+        std::stable_sort(matches.begin(), matches.end(), [](const fuzzy_match& lhs, const fuzzy_match& rhs) {
+            return lhs.distance < rhs.distance;
+        });
+        auto last_match = std::find_if(matches.begin(), matches.end(), [bound](const fuzzy_match& match) {
+            return match.distance > bound;
+        });
+        matches.erase(last_match, matches.end());
+        if (matches.size() > limit) {
+            matches.erase(matches.begin() + static_cast<std::ptrdiff_t>(limit), matches.end());
+        }
+        return matches;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::size_type radix_tree<Key, T, Split, Len, Allocator>::count_with_prefix(key_view_type prefix) const {
+        // number of keys starting with prefix, read off the highest node of their subtree
+        static_assert(counted, "count_with_prefix() needs a radix_subtree_count<T> specialization");
+        node_type* prefix_node = find_prefix_node(prefix);
+        return prefix_node != nullptr ? subtree_count(prefix_node) : 0;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::size_type radix_tree<Key, T, Split, Len, Allocator>::rank(key_view_type key) const {
+        /**
+         * Number of keys less than key, whether key is in the tree or not. Going down the path of key, a node whose
+         * key is a proper prefix of key comes before it, and so do the subtrees of the children on the left of the
+         * path:
+         *
+         * (root)
+         *   |____ (ab)             rank(abd) = 1 (ab) + 2 (c) subtree = 3
+         *           |____ (c)
+         *           |      |____ (ef)
+         *           |____ (d)
+         *           |____ (g)
+         */
+        static_assert(counted, "rank() needs a radix_subtree_count<T> specialization");
+        size_type key_len = get_key_len(key);
+        size_type result = 0;
+        node_type* node = root_node;
+        while (node != nullptr && node->depth < key_len) {
+            result += node->has_value() ? 1 : 0;
+
+            unit_type unit = key_unit(key, node->depth);
+            node_type* next_node = nullptr;
+            node->children.for_each([&result, &next_node, unit](const unit_type child_unit, node_type* child_node) {
+                if (child_unit < unit) {
+                    result += subtree_count(child_node);
+                } else if (child_unit == unit) {
+                    next_node = child_node;
+                }
+            });
+            if (next_node == nullptr) {
+                break;
+            }
+
+            key_view_type rest = split_key(key, node->depth);
+            size_type i = common_prefix_length(next_node->get_search_key(), rest);
+            if (i < next_node->label_len) {
+                // key leaves the path inside the label: the whole subtree is on one side of it
+                if (i < get_key_len(rest) && key_unit(next_node->get_search_key(), i) < key_unit(rest, i)) {
+                    result += subtree_count(next_node);
+                }
+                break;
+            }
+            node = next_node;
+        }
+        return result;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::iterator radix_tree<Key, T, Split, Len, Allocator>::select(size_type n) const {
+        // the key of rank n, counting from 0, end() if there are not that many keys
+        static_assert(counted, "select() needs a radix_subtree_count<T> specialization");
+        if (n >= tree_size) {
+            return end();
+        }
+
+        node_type* node = root_node;
+        while (true) {
+            if (node->has_value()) {
+                if (n == 0) {
+                    return iterator{node};
+                }
+                --n;
+            }
+
+            node_type* next_node = nullptr;
+            node->children.for_each([&n, &next_node](unit_type, node_type* child_node) {
+                if (next_node == nullptr) {
+                    size_type count = subtree_count(child_node);
+                    if (n < count) {
+                        next_node = child_node;
+                    } else {
+                        n -= count;
+                    }
+                }
+            });
+            node = next_node;
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    std::vector<typename radix_tree<Key, T, Split, Len, Allocator>::iterator> radix_tree<Key, T, Split, Len, Allocator>::top_k_with_prefix(key_view_type prefix, const size_type k) const {
+        /**
+         * The k keys starting with prefix whose values have the highest scores, best first, ties in no particular
+         * order. Best first search on the cached maxima: the frontier holds subtrees ranked by the best score in
+         * them and values ranked by their own score, and the best entry is expanded until k values came out on top.
+         * A subtree is only opened once its maximum beats everything else left, so the work depends on k and on the
+         * fanout along the way, not on how many keys start with prefix.
+         *
+         * (root)                           top_k_with_prefix(a, 1)
+         *   |____ (a)          max 9           (a) 9   ->  (b) 9, (c) 4    ->  value (ab) 9, (c) 4
+         *           |____ (b)  9, max 9                                    ->  (ab)
+         *           |____ (c)  max 4
+         *                  |____ (d) 4
+         *                  |____ (e) 1
+         */
+        static_assert(scored, "top_k_with_prefix() needs a radix_score<T> specialization");
+        using score_type = typename radix_score<T>::score_type;
+
+        struct candidate {
+            score_type score;
+            node_type* node;
+            bool value_only;            // the value of node rather than its whole subtree
+        };
+        auto lower_score = [](const candidate& lhs, const candidate& rhs) {
+            return lhs.score < rhs.score;
+        };
+
+        std::vector<iterator> result;
+        node_type* prefix_node = tree_size > 0 && k > 0 ? find_prefix_node(prefix) : nullptr;
+        if (prefix_node == nullptr) {
+            return result;
+        }
+
+        std::priority_queue<candidate, std::vector<candidate>, decltype(lower_score)> frontier{lower_score};
+        frontier.push(candidate{prefix_node->max_score, prefix_node, false});
+        while (!frontier.empty() && result.size() < k) {
+            candidate best = frontier.top();
+            frontier.pop();
+            if (best.value_only) {
+                result.push_back(iterator{best.node});
+                continue;
+            }
+
+            if (best.node->has_value()) {
+                frontier.push(candidate{radix_score<T>::get(*best.node->value), best.node, true});
+            }
+            best.node->children.for_each([&frontier](unit_type, node_type* child_node) {
+                frontier.push(candidate{child_node->max_score, child_node, false});
+            });
+        }
+        return result;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    inline std::pair<typename radix_tree<Key, T, Split, Len, Allocator>::iterator, bool> radix_tree<Key, T, Split, Len, Allocator>::insert(const value_type& value) {
+        return try_emplace(value.first, value.second);
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    inline std::pair<typename radix_tree<Key, T, Split, Len, Allocator>::iterator, bool> radix_tree<Key, T, Split, Len, Allocator>::insert(value_type&& value) {
+        // the key of a pair is const even in an rvalue, only the mapped value can be moved
+        return try_emplace(value.first, std::move(value.second));
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    template <typename... Args>
+    std::pair<typename radix_tree<Key, T, Split, Len, Allocator>::iterator, bool> radix_tree<Key, T, Split, Len, Allocator>::emplace(Args&&... args) {
+        // the key is only known once the pair exists, its mapped value is then moved into the tree
+        value_type value(std::forward<Args>(args)...);
+        return try_emplace(value.first, std::move(value.second));
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    template <typename M>
+    std::pair<typename radix_tree<Key, T, Split, Len, Allocator>::iterator, bool> radix_tree<Key, T, Split, Len, Allocator>::insert_or_assign(key_view_type key, M&& obj) {
+        auto result = try_emplace(key, std::forward<M>(obj));
+        if (!result.second) {
+            // try_emplace has not touched obj, the key was already there
+            *result.first.pointed_node->value = std::forward<M>(obj);
+            refresh_max_score(result.first.pointed_node);
         }
+        return result;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    inline void radix_tree<Key, T, Split, Len, Allocator>::refresh_score(const iterator& position) {
+        // to call after the score of the value at position was changed in place, a no-op for values without a score
+        refresh_max_score(position.pointed_node);
+    }
 
-        if (!found_common_branch) {
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    template <typename... Args>
+    std::pair<typename radix_tree<Key, T, Split, Len, Allocator>::iterator, bool> radix_tree<Key, T, Split, Len, Allocator>::try_emplace(key_view_type key, Args&&... args) {
+        /**
+         * The mapped value is constructed from args only once the key is known to be absent, directly in the
+         * storage it keeps until it is erased, and before the tree changes shape: a throwing constructor leaves the
+         * tree as it was.
+         */
+        return emplace_below(get_root_node(), key, std::forward<Args>(args)...);
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    inline typename radix_tree<Key, T, Split, Len, Allocator>::iterator radix_tree<Key, T, Split, Len, Allocator>::insert(const iterator& hint, const value_type& value) {
+        // hint is best the iterator returned by the previous insert, when keys come in sorted or clustered order
+        return emplace_below(hint_start_node(hint, value.first), value.first, value.second).first;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    inline typename radix_tree<Key, T, Split, Len, Allocator>::iterator radix_tree<Key, T, Split, Len, Allocator>::insert(const iterator& hint, value_type&& value) {
+        return emplace_below(hint_start_node(hint, value.first), value.first, std::move(value.second)).first;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    template <typename... Args>
+    std::pair<typename radix_tree<Key, T, Split, Len, Allocator>::iterator, bool> radix_tree<Key, T, Split, Len, Allocator>::emplace_below(node_type* start_node, key_view_type key, Args&&... args) {
+        /**
+         * One descent from start_node, whose key is a prefix of key. Comparing the label of each child with key
+         * tells at once whether to go down and, if not, where the label has to be split.
+         */
+        size_type key_len = get_key_len(key);
+        node_type* parent_node = start_node;
+        node_type* child_node = nullptr;
+        size_type i = 0;                // common length of the label of child_node and the rest of key
+        while (parent_node->depth < key_len) {
+            child_node = parent_node->children.find(key_unit(key, parent_node->depth));
+            if (child_node == nullptr) {
+                break;
+            }
+
+            i = common_prefix_length(child_node->get_search_key(), split_key(key, parent_node->depth));
+            if (i < child_node->label_len) {
+                break;
+            }
+            parent_node = child_node;
+            child_node = nullptr;
+        }
+
+        iterator parent_it{parent_node};
+        key_view_type sub_key = split_key(key, parent_node->depth);
+        auto sub_key_len = get_key_len(sub_key);
+
+        if (sub_key_len == 0) {
+            /**
+             * The key ends exactly at parent node, e.g. insert (ab) below
+             *
+             * (root)
+             *   |____ (ab)
+             *           |____ (c)
+             *           |____ (d)
+             */
+            if (parent_node->has_value()) {
+                return std::pair<iterator, bool>(parent_it, false);
+            }
+
+            parent_node->value = create_value(std::forward<Args>(args)...);
+            add_subtree_count(parent_node, 1);
+            refresh_max_score(parent_node);
+            tree_size++;
+            return std::pair<iterator, bool>(parent_it, true);
+        }
+
+        if (child_node == nullptr) {
             /**
              * Current keys : (abc)
              *
@@ -234,53 +1176,264 @@ namespace phamphilong {
              *
              * (root)
              *   |____ (abc)
-             *           |____ ()
              *           |____ (ef)
              *
              */
-            if ((parent_it.pointed_node != root_node) && parent_it.pointed_node->is_leaf()) {
-                parent_it.pointed_node->children.insert(std::pair<key_type , node_type*>(
-                        key_type{},
-                        new node_type {
-                                *parent_it.pointed_node->value,            // value
-                                parent_it.pointed_node,                    // parent_node
-                                parent_it.pointed_node->depth              // depth
-                        }
-                ));
+            value_holder new_value{create_value(std::forward<Args>(args)...), value_deleter{this}};
+            auto new_node = create_node(
+                    sub_key,                         // label
+                    parent_node,                     // parent_node
+                    get_key_len(key)                 // depth
+            );
+            try {
+                parent_node->children.insert(key_unit(sub_key, 0), new_node, allocator);
+            } catch (...) {
+                destroy_node(new_node);
+                throw;
+            }
+            new_node->value = new_value.release();
+            add_subtree_count(new_node, 1);
+            refresh_max_score(new_node);
+
+            tree_size++;
+            return std::pair<iterator, bool>(new_node, true);
+        }
+
+        /**
+         * Current keys : (abc), (abcef)
+         *
+         * (root)
+         *   |____ (abc)
+         *           |____ (ef)
+         *
+         * insert key (abd)
+         *
+         * (root)
+         *   |____ (ab)
+         *           |____ (c)
+         *           |      |____ (ef)
+         *           |____ (d)
+         *
+         *  parent_node = (root)
+         *  child_node = (abc)
+         *  new_node = (d)
+         *  new_parent_node = (ab)
+         *
+         *  Algorithm:
+         *      (step 1) allocate new parent node (ab), new node (d) unless the key ends at (ab), the children table
+         *               of (ab) and the shortened label of child node (abc): every step that can throw comes first
+         *      (step 2) transform child node (abc) to (c), add it to the children table of new parent node (ab)
+         *      (step 3) replace child node (abc) by new parent node (ab) in parent node (root) children table
+         *      (step 4) add new node (d) to (ab) children table, or store the value in (ab) if the key ends there
+         *
+         */
+        key_view_type child_key = child_node->get_search_key();
+        value_holder new_value{create_value(std::forward<Args>(args)...), value_deleter{this}};
+
+        // (step 1) allocate everything, the tree is left as it was if any of it throws
+        auto new_parent_node = create_node(
+                split_key(child_key, 0, i),                 // label
+                parent_node,                                // parent_node
+                parent_node->depth + i                      // depth
+        );
+        node_type* new_node = nullptr;
+        try {
+            if (i < sub_key_len) {
+                new_node = create_node(
+                        split_key(sub_key, i),              // label
+                        new_parent_node,                    // parent_node
+                        get_key_len(key)                    // depth
+                );
+            }
+            new_parent_node->children.reserve(new_node != nullptr ? 2 : 1, allocator);
+            // leaves child node (abc) untouched if it throws, child_key is not used past this point
+            assign_label(child_node, split_key(child_key, i));
+        } catch (...) {
+            if (new_node != nullptr) {
+                destroy_node(new_node);
+            }
+            destroy_node(new_parent_node);
+            throw;
+        }
+
+        // (step 2) child node (c) goes below new parent node (ab), the reserved table does not grow
+        child_node->parent_node = new_parent_node;
+        new_parent_node->children.insert(child_node->get_search_unit(), child_node, allocator);
+        copy_subtree_count(new_parent_node, child_node);
+        raise_max_score(new_parent_node, child_node);
+
+        // (step 3) replace child node (abc) by new parent node (ab) in parent node (root) children table
+        parent_node->children.replace(new_parent_node->get_search_unit(), new_parent_node);
+        event_counters().count_insert_split();
+
+        // (step 4) add new node (d) to (ab) children table
+        if (new_node == nullptr) {
+            new_parent_node->value = new_value.release();
+            add_subtree_count(new_parent_node, 1);
+            refresh_max_score(new_parent_node);
+            tree_size++;
+            return std::pair<iterator, bool>(new_parent_node, true);
+        }
 
-                parent_it.pointed_node->value->second = mapped_type{};
+        new_parent_node->children.insert(new_node->get_search_unit(), new_node, allocator);
+        new_node->value = new_value.release();
+        add_subtree_count(new_node, 1);
+        refresh_max_score(new_node);
+
+        tree_size++;
+        return std::pair<iterator, bool>(new_node, true);
+    }
+
+    /**
+     * Builds a tree bottom-up from keys in increasing order, in one pass and without ever splitting a node.
+     *
+     * The nodes on the path of the last key are kept open on a stack. With l the longest common prefix of the last
+     * key and the next one, every open node deeper than l is complete: it is popped and attached to the node below
+     * it on the stack, or to a new node of depth l if that node is shallower than l. The next key then opens a node
+     * of its own on top. A node learns its edge label when it is attached, from the last key, which runs through it.
+     *
+     * Current keys : (abc), (abcef) then add (abd), l = 2
+     *
+     *      stack: (root) (abc) (abcef)     ->  (abcef) is attached to (abc), (abc) to a new node (ab)
+     *      stack: (root) (ab) (abd)
+     */
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    class radix_tree<Key, T, Split, Len, Allocator>::bulk_loader {
+    public:
+        explicit bulk_loader(radix_tree& tree) : tree{tree} {
+            tree.clear();
+            tree.root_node = tree.create_node(key_view_type{}, nullptr, 0);
+            open_nodes.push_back(tree.root_node);
+        }
+
+        bulk_loader(const bulk_loader&) = delete;
+        bulk_loader& operator= (const bulk_loader&) = delete;
+
+        ~bulk_loader() {
+            if (!finished) {
+                // something threw, drop the nodes that are not attached yet and leave an empty tree
+                for (size_type i = open_nodes.size() - 1; i > 0; --i) {
+                    tree.destroy_subtree(open_nodes[i]);
+                }
+                tree.clear();
             }
+        }
 
-            auto new_node = parent_it.pointed_node->children.insert(std::pair<Key, node_type*>(
-                    sub_key,
-                    new node_type{
-                            value,                           // value
-                            parent_it.pointed_node,          // parent_node
-                            get_key_len(value.first)         // depth
+        void add(key_view_type key, const mapped_type& value) {
+            if (!sorted) {
+                tree.insert(value_type{key_type{key}, value});
+                return;
+            }
+
+            size_type key_len = tree.get_key_len(key);
+            if (tree.tree_size > 0) {
+                key_view_type last = last_key();
+                size_type last_len = tree.get_key_len(last);
+                size_type common_len = tree.common_prefix_length(last, key);
+                if (common_len == key_len || (common_len < last_len && key_unit(last, common_len) > key_unit(key, common_len))) {
+                    if (common_len == last_len) {
+                        return;         // duplicated key, the first one wins like with insert()
                     }
-            ));
 
-            auto new_node_it = parent_it.pointed_node->children.find(sub_key);
-            if (new_node.second && (new_node_it != parent_it.pointed_node->children.end())) {
-                tree_size++;
-                return std::pair<iterator, bool>(new_node_it->second, true);
+                    // out of order, finish what is built so far and insert the rest one by one
+                    finish();
+                    sorted = false;
+                    tree.insert(value_type{key_type{key}, value});
+                    return;
+                }
+
+                close_nodes(common_len);
             }
+
+            node_type* node = open_nodes.back();
+            if (node->depth != key_len) {
+                open_nodes.reserve(open_nodes.size() + 1);
+                node = tree.create_node(key_view_type{}, nullptr, key_len);
+                open_nodes.push_back(node);
+            }
+            node->value = tree.create_value(value);
+            add_subtree_count(node, 1);            // open nodes have no parent yet, only node counts it
+            refresh_max_score(node);
+            last_key_units.assign(key.data(), key_len);
+            tree.tree_size++;
+        }
+
+        void finish() {
+            if (!finished) {
+                close_nodes(0);
+                finished = true;
+            }
+        }
+
+    private:
+        radix_tree& tree;
+        std::vector<node_type*> open_nodes{};
+        std::basic_string<char_type> last_key_units{};
+        bool sorted{true};
+        bool finished{false};
+
+        key_view_type last_key() const {
+            return key_view_type(last_key_units.data(), last_key_units.size());
         }
 
-        return std::pair<iterator, bool>(end(), false);
+        void close_nodes(const size_type common_len) {
+            // a node stays open until it is attached, so that if anything throws the destructor still frees it
+            while (open_nodes.back()->depth > common_len) {
+                node_type* node = open_nodes.back();
+                node_type* parent_node = open_nodes[open_nodes.size() - 2];
+                if (parent_node->depth < common_len) {
+                    // a branch node at common_len goes in between, inserting it into reserved room cannot throw
+                    open_nodes.reserve(open_nodes.size() + 1);
+                    parent_node = tree.create_node(key_view_type{}, nullptr, common_len);
+                    open_nodes.insert(open_nodes.end() - 1, parent_node);
+                }
+
+                // label of node is the part of the last key between its parent and itself
+                tree.assign_label(node, tree.split_key(last_key(), parent_node->depth, node->depth - parent_node->depth));
+                parent_node->children.insert(node->get_search_unit(), node, tree.allocator);
+                node->parent_node = parent_node;
+                open_nodes.pop_back();
+                attach_subtree_count(parent_node, node);
+                raise_max_score(parent_node, node);
+            }
+        }
+    };
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    template <typename InputIt>
+    void radix_tree<Key, T, Split, Len, Allocator>::assign(InputIt first, InputIt last) {
+        // linear time if [first, last) is sorted by key, unsorted entries are inserted one by one
+        bulk_loader loader{*this};
+        for (; first != last; ++first) {
+            const auto& value = *first;
+            loader.add(key_view_type(value.first), value.second);
+        }
+        loader.finish();
     }
 
-    template <typename Key, typename T, typename Split, typename Len>
-    inline typename radix_tree<Key, T, Split, Len>::size_type radix_tree<Key, T, Split, Len>::size() const noexcept {
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    void radix_tree<Key, T, Split, Len, Allocator>::assign(std::istream& sorted_keys, const mapped_type& value) {
+        // one key per line, every key is mapped to value
+        bulk_loader loader{*this};
+        std::basic_string<char_type> line;
+        while (std::getline(sorted_keys, line)) {
+            loader.add(key_view_type(line.data(), line.size()), value);
+        }
+        loader.finish();
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    inline typename radix_tree<Key, T, Split, Len, Allocator>::size_type radix_tree<Key, T, Split, Len, Allocator>::size() const noexcept {
         return tree_size;
     };
 
-    template <typename Key, typename T, typename Split, typename Len>
-    typename radix_tree<Key, T, Split, Len>::size_type radix_tree<Key, T, Split, Len>::erase(const key_type& key) {
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::size_type radix_tree<Key, T, Split, Len, Allocator>::erase(key_view_type key) {
         if (root_node == nullptr) {
             return 0;
         }
 
+        event_counters().count_lookup();
         auto found_node_it = find_node(key, 0, root_node);
         if (found_node_it == end()) {
             return 0;
@@ -292,37 +1445,290 @@ namespace phamphilong {
          * (root)
          *   |____ (ab)
          *           |____ (c)
-         *           |      |____ ()
          *           |      |____ (ef)
          *           |____ (d)
          *           |____ (g)
          *
          *   delete (abg) : simply delete (g)
-         *   delete (abc) : delete () then merge (c) and (ef) to form (cef)
+         *   delete (abc) : drop the value of (c) then merge (c) and (ef) to form (cef)
          *
+         * The joined label of a merge may need an allocation, the only step that can throw, so a merge comes first,
+         * while nothing else has changed. The rest cannot fail: the structure changes, then the value and nodes go,
+         * then the counts, scores and size follow.
          */
-        node_type* parent_node = found_node_it.pointed_node->parent_node;
-        parent_node->children.erase(found_node_it.pointed_node->get_search_key());
-        delete found_node_it.pointed_node;
-
-        if (parent_node->children.size() == 1 && parent_node->parent_node != nullptr) {
-            // merge the parent node with its now only child (the only sibling of the erased node)
-            node_type* grand_parent_node = parent_node->parent_node;
-            node_type* sibling_node = parent_node->children.begin()->second;
-            parent_node->children.erase(sibling_node->get_search_key());
-            grand_parent_node->children.erase(parent_node->get_search_key());
-            delete parent_node;
-            sibling_node->parent_node = grand_parent_node;
-            grand_parent_node->children.insert(std::make_pair(sibling_node->get_search_key(), sibling_node));
+        node_type* found_node = found_node_it.pointed_node;
+        node_type* changed_node = found_node;       // deepest node left whose subtree lost the value
+        if (found_node->is_root() || found_node->children.size() > 1) {
+            // the node stays, e.g. the root for the empty key
+            destroy_value(found_node->value);
+            found_node->value = nullptr;
+        } else if (found_node->is_leaf()) {
+            node_type* parent_node = found_node->parent_node;
+            changed_node = parent_node;
+            if (!parent_node->is_root() && !parent_node->has_value() && parent_node->children.size() == 2) {
+                // the parent node is left with a single child, the sibling of the erased node, merge them
+                node_type* sibling_node = parent_node->children.first();
+                if (sibling_node == found_node) {
+                    sibling_node = parent_node->children.next(found_node->get_search_unit());
+                }
+                changed_node = merge_with_only_child(parent_node, sibling_node)->parent_node;
+            } else {
+                parent_node->children.erase(found_node->get_search_unit(), allocator);
+            }
+            destroy_node(found_node);
+        } else {
+            // a single child, the node goes with its value
+            changed_node = merge_with_only_child(found_node, found_node->children.first())->parent_node;
         }
 
+        subtract_subtree_count(changed_node, 1);
+        refresh_max_score(changed_node);
         tree_size--;
         return 1;
     }
 
-    template <typename Key, typename T, typename Split, typename Len>
-    inline void radix_tree<Key, T, Split, Len>::clear() noexcept {
-        delete root_node;
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    typename radix_tree<Key, T, Split, Len, Allocator>::node_type* radix_tree<Key, T, Split, Len, Allocator>::merge_with_only_child(node_type* node, node_type* only_child) {
+        /**
+         * (ab) has a single child (c) left, once its value and its other children, if any, are dropped:
+         *
+         * (root)
+         *   |____ (ab)
+         *           |____ (c)
+         *
+         * becomes
+         *
+         * (root)
+         *   |____ (abc)
+         *
+         * The joined label is assigned while (c) is still linked, if it throws nothing has changed. Relinking (c) and
+         * destroying (ab) with its value and table cannot fail, the table does not own the children left in it.
+         */
+        node_type* parent_node = node->parent_node;
+        assign_label(only_child, node->get_search_key(), only_child->get_search_key());
+
+        only_child->parent_node = parent_node;
+        parent_node->children.replace(node->get_search_unit(), only_child);
+        destroy_node(node);
+        event_counters().count_erase_merge();
+        return only_child;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    void radix_tree<Key, T, Split, Len, Allocator>::compact() {
+        /**
+         * Rebuilds the tree into new memory in depth first order: the nodes one after the other, then the children
+         * tables at their final sizes, then the values, so a scan walks memory forward instead of jumping all over
+         * the heap after a long history of splits and merges. With a radix_tree_pool_allocator the tree uses alone,
+         * the new layout goes to a fresh pool, i.e. contiguous chunks, and the old pool is released at once.
+         *
+         * Only ordered scans (iteration, prefix and range queries) are expected to get faster. A lookup touches one
+         * node per level, far apart in depth first order once the subtrees are large, and the tables and values it
+         * reads sit in their own regions: find may come out a little faster or slower, compact_bench shows either
+         * from run to run.
+         *
+         * Stop the world: the whole tree is copied at once and nothing else may use it meanwhile, compact_into()
+         * builds the copy while readers carry on. Values are moved if that cannot throw, copied otherwise, after all the
+         * allocations: if one of them fails the tree is left as it was. Iterators are invalidated.
+         */
+        if (root_node == nullptr) {
+            return;
+        }
+
+        radix_tree compacted{compaction_allocator(allocator, 0)};
+        if constexpr (std::is_nothrow_move_constructible<mapped_type>::value) {
+            std::vector<relocation> relocations;
+            relocations.reserve(tree_size);
+            value_allocator_type value_allocator(compacted.allocator);
+            try {
+                compacted.copy_from(*this, &relocations);
+            } catch (...) {
+                for (auto& moved : relocations) {
+                    value_alloc_traits::deallocate(value_allocator, moved.storage, 1);
+                }
+                throw;
+            }
+
+            for (auto& moved : relocations) {
+                value_alloc_traits::construct(value_allocator, moved.storage, std::move(*moved.value));
+                moved.node->value = moved.storage;
+            }
+        } else {
+            compacted.copy_from(*this, nullptr);
+        }
+
+        // the old layout goes away with compacted
+        swap(compacted);
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    void radix_tree<Key, T, Split, Len, Allocator>::compact_into(radix_tree& target) const {
+        /**
+         * Builds a compacted copy of the tree into target, replacing its content, with target's allocator. The tree
+         * is only read, so this can run on a background thread alongside other readers, then the copy replaces the
+         * tree with swap() under the writers' lock. This is not incremental: writers are locked out for the whole
+         * copy, or their writes since it started are lost with the old layout, and target is unusable until it
+         * returns.
+         *
+         *      radix_tree<std::string, int> fresh;
+         *      tree.compact_into(fresh);       // background, readers carry on
+         *      tree.swap(fresh);               // writers locked out, fresh now frees the old layout
+         */
+        target.clear();
+        if (root_node == nullptr) {
+            return;
+        }
+
+        try {
+            target.copy_from(*this, nullptr);
+        } catch (...) {
+            target.clear();
+            throw;
+        }
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    void radix_tree<Key, T, Split, Len, Allocator>::swap(radix_tree& other) noexcept {
+        using std::swap;
+        swap(allocator, other.allocator);
+        swap(root_node, other.root_node);
+        swap(tree_size, other.tree_size);
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    void radix_tree<Key, T, Split, Len, Allocator>::copy_from(const radix_tree& source, std::vector<relocation>* relocations) {
+        /**
+         * Into this empty tree, in three passes over the nodes in depth first order: the nodes with their heap labels,
+         * then the children tables, then the values. Blocks of one kind end up back to back, which a pool packs without
+         * the alignment gaps that interleaving 64 byte nodes with smaller blocks would leave, and each pass still lays
+         * its blocks out in scan order. With relocations, value storage is only allocated and listed.
+         */
+        std::vector<std::pair<const node_type*, node_type*>> nodes;     // source node, copy, in depth first order
+        nodes.reserve(2 * source.tree_size + 1);
+        size_type linked_count = 0;
+        try {
+            std::vector<std::pair<const node_type*, node_type*>> pending{{source.root_node, nullptr}};
+            while (!pending.empty()) {
+                const node_type* source_node = pending.back().first;
+                node_type* parent_node = pending.back().second;
+                pending.pop_back();
+
+                node_type* node = create_node(source_node->get_search_key(), parent_node, source_node->depth);
+                copy_subtree_count(node, source_node);
+                raise_max_score(node, source_node);
+                nodes.emplace_back(source_node, node);
+                size_type mark = pending.size();
+                source_node->children.for_each([&pending, node](unit_type, node_type* child_node) {
+                    pending.emplace_back(child_node, node);
+                });
+                std::reverse(pending.begin() + static_cast<std::ptrdiff_t>(mark), pending.end());
+            }
+
+            // a parent comes before its children and its table is allocated at its final size, linking never allocates
+            for (auto& copied : nodes) {
+                node_type* node = copied.second;
+                if (node->parent_node == nullptr) {
+                    root_node = node;
+                } else {
+                    node->parent_node->children.insert(node->get_search_unit(), node, allocator);
+                }
+                ++linked_count;
+                node->children.reserve(copied.first->children.size(), allocator);
+            }
+        } catch (...) {
+            for (size_type index = linked_count; index < nodes.size(); ++index) {
+                destroy_node(nodes[index].second);
+            }
+            throw;
+        }
+
+        for (auto& copied : nodes) {
+            if (copied.first->has_value()) {
+                if (relocations != nullptr) {
+                    value_allocator_type value_allocator(allocator);
+                    relocations->push_back(relocation{copied.second, value_alloc_traits::allocate(value_allocator, 1), copied.first->value});
+                } else {
+                    copied.second->value = create_value(*copied.first->value);
+                }
+            }
+        }
+        tree_size = source.tree_size;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    radix_tree_stats radix_tree<Key, T, Split, Len, Allocator>::stats() const {
+        /**
+         * Walks every node once, depth first with an explicit stack so that deep trees cannot overflow the call
+         * stack.
+         *
+         * (root)                   depth 0, fanout 1
+         *   |____ (ab)             depth 1, fanout 2, split node
+         *           |____ (c)      depth 2, leaf
+         *           |____ (d)      depth 2, leaf
+         */
+        radix_tree_stats result;
+        if (root_node == nullptr) {
+            return result;
+        }
+
+        std::vector<std::pair<const node_type*, size_type>> pending{{root_node, 0}};
+        while (!pending.empty()) {
+            const node_type* node = pending.back().first;
+            size_type depth = pending.back().second;
+            pending.pop_back();
+
+            size_type fanout = node->children.size();
+            result.node_count++;
+            result.node_bytes += sizeof(node_type);
+            result.children_bytes += node->children.table_bytes();
+            if (node->has_value()) {
+                result.value_count++;
+                result.value_bytes += sizeof(mapped_type);
+            } else if (!node->is_root()) {
+                result.split_node_count++;
+            }
+            if (fanout == 0) {
+                result.leaf_count++;
+            }
+            if (!node->is_root()) {
+                result.total_label_length += node->label_len;
+            }
+            if (!node->has_inline_label()) {
+                result.heap_label_count++;
+                result.label_bytes += node->label_len * sizeof(char_type);
+            }
+
+            if (result.fanout_histogram.size() <= fanout) {
+                result.fanout_histogram.resize(fanout + 1);
+            }
+            result.fanout_histogram[fanout]++;
+            if (result.depth_histogram.size() <= depth) {
+                result.depth_histogram.resize(depth + 1);
+            }
+            result.depth_histogram[depth]++;
+            result.max_depth = std::max(result.max_depth, depth);
+
+            node->children.for_each([&pending, depth](unit_type, node_type* child_node) {
+                pending.emplace_back(child_node, depth + 1);
+            });
+        }
+
+        return result;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator>
+    void radix_tree<Key, T, Split, Len, Allocator>::clear() noexcept {
+        if (root_node != nullptr) {
+            // with a pool allocator that only this tree uses, trivially destructible nodes are dropped together with
+            // the pool chunks, otherwise every node is destroyed first and the pool gives its chunks back afterwards
+            constexpr bool trivial_nodes = std::is_trivially_destructible<node_type>::value &&
+                                           std::is_trivially_destructible<mapped_type>::value;
+            if (!trivial_nodes || !release_allocator(allocator, 0)) {
+                destroy_subtree(root_node);
+                release_allocator(allocator, 0);
+            }
+        }
+
         root_node = nullptr;
         tree_size = 0;
     }
@@ -0,0 +1,652 @@
+//
+// Adaptive child table of a radix tree node.
+//
+
+#ifndef PHAM_PHI_LONG_RADIX_TREE_CHILDREN_H
+#define PHAM_PHI_LONG_RADIX_TREE_CHILDREN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace phamphilong {
+    /**
+     * Children of a radix tree node, indexed by the first key unit of their edge label.
+     *
+     * The layout grows and shrinks with the fanout, read:
+     *      https://db.in.tum.de/~leis/papers/ART.pdf
+     * for the idea.
+     *
+     *      node4   : up to 4 children, sorted unit array, linear scan
+     *      node16  : up to 16 children, sorted unit array, SIMD compare
+     *      node48  : up to 48 children, 256 slot index into a child array
+     *      node256 : direct 256 slot child table
+     *
+     * node48 and node256 also keep a 256 bit occupancy bitmap, so first() and next() are a few word scans instead
+     * of a walk over up to 256 slots.
+     *
+     * Units of node4/node16 are kept sorted, so every layout hands out its children in key order.
+     *
+     * The table does not own its children, and its storage comes from the allocator passed to the
+     * mutating functions, the owner has to call clear() with the same allocator before dropping it.
+     */
+    template <typename Node>
+    class radix_tree_children {
+    public:
+        using unit_type = unsigned char;
+        using size_type = std::size_t;
+
+        radix_tree_children() = default;
+        radix_tree_children(const radix_tree_children&) = delete;
+        radix_tree_children& operator= (const radix_tree_children&) = delete;
+
+        Node* find(const unit_type unit) const noexcept;
+        Node* first() const noexcept;
+        Node* next(const unit_type unit) const noexcept;
+        template <typename Alloc> void insert(const unit_type unit, Node* child, Alloc& alloc);
+        template <typename Alloc> void reserve(const size_type child_count, Alloc& alloc);
+        void replace(const unit_type unit, Node* child) noexcept;
+        template <typename Alloc> void erase(const unit_type unit, Alloc& alloc) noexcept;
+        template <typename Alloc> void clear(Alloc& alloc) noexcept;
+        template <typename Visitor> void for_each(Visitor visitor) const;
+        void prefetch(const unit_type unit) const noexcept;
+
+        static void prefetch_address(const void* address) noexcept {
+            // hint only, a no-op where the compiler has no prefetch builtin
+#if defined(__GNUC__)
+            __builtin_prefetch(address);
+#else
+            (void) address;
+#endif
+        }
+
+        size_type size() const noexcept {
+            return count;
+        }
+
+        bool empty() const noexcept {
+            return count == 0;
+        }
+
+        size_type table_bytes() const noexcept {
+            // size of the table the children live in, 0 without children
+            switch (table_layout) {
+                case layout::node4:
+                    return sizeof(node4);
+                case layout::node16:
+                    return sizeof(node16);
+                case layout::node48:
+                    return sizeof(node48);
+                case layout::node256:
+                    return sizeof(node256);
+                default:
+                    return 0;
+            }
+        }
+
+    private:
+        enum class layout : std::uint8_t { none, node4, node16, node48, node256 };
+
+        struct unit_bitmap {
+            std::uint64_t words[4];
+
+            void set(const unit_type unit) noexcept {
+                words[unit >> 6] |= std::uint64_t{1} << (unit & 63);
+            }
+
+            void reset(const unit_type unit) noexcept {
+                words[unit >> 6] &= ~(std::uint64_t{1} << (unit & 63));
+            }
+
+            size_type find_from(const size_type unit) const noexcept {
+                // first set unit not below `unit`, 256 if there is none
+                for (size_type word = unit >> 6; word < 4; ++word) {
+                    std::uint64_t bits = words[word];
+                    if (word == (unit >> 6)) {
+                        bits &= ~std::uint64_t{0} << (unit & 63);
+                    }
+                    if (bits) {
+                        return word * 64 + count_trailing_zeros(bits);
+                    }
+                }
+                return 256;
+            }
+        };
+
+        struct node4 {
+            unit_type units[4];
+            Node* children[4];
+        };
+
+        struct node16 {
+            unit_type units[16];
+            Node* children[16];
+        };
+
+        struct node48 {
+            unit_bitmap present;
+            std::uint8_t index[256];        // slot + 1 in children, 0 means no child
+            Node* children[48];
+        };
+
+        struct node256 {
+            unit_bitmap present;
+            Node* children[256];
+        };
+
+        layout table_layout{layout::none};
+        std::uint16_t count{0};
+        void* table{nullptr};
+
+        Node** find_slot(const unit_type unit) const noexcept;
+        Node* find_from(const size_type unit) const noexcept;
+        template <typename Alloc> void grow(Alloc& alloc);
+        template <typename Alloc> void shrink(Alloc& alloc) noexcept;
+
+        template <typename Table, typename Alloc>
+        static Table* allocate_table(Alloc& alloc) {
+            using table_allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<Table>;
+            table_allocator_type table_alloc(alloc);
+            Table* new_table = std::allocator_traits<table_allocator_type>::allocate(table_alloc, 1);
+            return ::new (static_cast<void*>(new_table)) Table{};
+        }
+
+        template <typename Table, typename Alloc>
+        static Table* try_allocate_table(Alloc& alloc) noexcept {
+            // nullptr if the allocator throws, for shrinking which may just keep the larger table
+            try {
+                return allocate_table<Table>(alloc);
+            } catch (...) {
+                return nullptr;
+            }
+        }
+
+        template <typename Table, typename Alloc>
+        static void deallocate_table(void* old_table, Alloc& alloc) noexcept {
+            // tables are trivial, there is nothing to destroy
+            using table_allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<Table>;
+            table_allocator_type table_alloc(alloc);
+            std::allocator_traits<table_allocator_type>::deallocate(table_alloc, static_cast<Table*>(old_table), 1);
+        }
+
+        static size_type count_trailing_zeros(const std::uint64_t bits) noexcept {
+#if defined(__GNUC__)
+            return static_cast<size_type>(__builtin_ctzll(bits));
+#else
+            size_type zeros = 0;
+            for (std::uint64_t rest = bits; (rest & 1) == 0; rest >>= 1) {
+                ++zeros;
+            }
+            return zeros;
+#endif
+        }
+
+        template <typename Table>
+        static void insert_sorted(Table* sorted_table, const size_type size, const unit_type unit, Node* child) noexcept {
+            size_type pos = size;
+            for (; pos > 0 && sorted_table->units[pos - 1] > unit; --pos) {
+                sorted_table->units[pos] = sorted_table->units[pos - 1];
+                sorted_table->children[pos] = sorted_table->children[pos - 1];
+            }
+
+            sorted_table->units[pos] = unit;
+            sorted_table->children[pos] = child;
+        }
+
+        template <typename Table>
+        static void erase_sorted(Table* sorted_table, const size_type size, const unit_type unit) noexcept {
+            size_type pos = 0;
+            for (; pos < size && sorted_table->units[pos] != unit; ++pos) {}
+            for (; pos + 1 < size; ++pos) {
+                sorted_table->units[pos] = sorted_table->units[pos + 1];
+                sorted_table->children[pos] = sorted_table->children[pos + 1];
+            }
+        }
+
+        template <typename Table>
+        static Node* next_sorted(const Table* sorted_table, const size_type size, const unit_type unit) noexcept {
+            for (size_type i = 0; i < size; ++i) {
+                if (sorted_table->units[i] > unit) {
+                    return sorted_table->children[i];
+                }
+            }
+
+            return nullptr;
+        }
+    };
+
+    template <typename Node>
+    Node** radix_tree_children<Node>::find_slot(const unit_type unit) const noexcept {
+        switch (table_layout) {
+            case layout::node4: {
+                auto node = static_cast<node4*>(table);
+                for (size_type i = 0; i < count; ++i) {
+                    if (node->units[i] == unit) {
+                        return &node->children[i];
+                    }
+                }
+                return nullptr;
+            }
+            case layout::node16: {
+                auto node = static_cast<node16*>(table);
+#if defined(__SSE2__)
+                __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(unit)),
+                                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(node->units)));
+                unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(cmp)) & ((1u << count) - 1);
+                return mask ? &node->children[__builtin_ctz(mask)] : nullptr;
+#else
+                for (size_type i = 0; i < count; ++i) {
+                    if (node->units[i] == unit) {
+                        return &node->children[i];
+                    }
+                }
+                return nullptr;
+#endif
+            }
+            case layout::node48: {
+                auto node = static_cast<node48*>(table);
+                return node->index[unit] ? &node->children[node->index[unit] - 1] : nullptr;
+            }
+            case layout::node256: {
+                auto node = static_cast<node256*>(table);
+                return node->children[unit] ? &node->children[unit] : nullptr;
+            }
+            default:
+                return nullptr;
+        }
+    }
+
+    template <typename Node>
+    inline Node* radix_tree_children<Node>::find(const unit_type unit) const noexcept {
+        Node** slot = find_slot(unit);
+        return slot ? *slot : nullptr;
+    }
+
+    template <typename Node>
+    inline void radix_tree_children<Node>::prefetch(const unit_type unit) const noexcept {
+        // bring in the cache line find(unit) reads first
+        switch (table_layout) {
+            case layout::node4:
+            case layout::node16:
+                prefetch_address(table);
+                break;
+            case layout::node48:
+                prefetch_address(&static_cast<node48*>(table)->index[unit]);
+                break;
+            case layout::node256:
+                prefetch_address(&static_cast<node256*>(table)->children[unit]);
+                break;
+            default:
+                break;
+        }
+    }
+
+    template <typename Node>
+    Node* radix_tree_children<Node>::find_from(const size_type unit) const noexcept {
+        // first child of node48/node256 whose unit is not below `unit`
+        if (table_layout == layout::node48) {
+            auto node = static_cast<node48*>(table);
+            size_type found = node->present.find_from(unit);
+            return found < 256 ? node->children[node->index[found] - 1] : nullptr;
+        }
+
+        auto node = static_cast<node256*>(table);
+        size_type found = node->present.find_from(unit);
+        return found < 256 ? node->children[found] : nullptr;
+    }
+
+    template <typename Node>
+    Node* radix_tree_children<Node>::first() const noexcept {
+        switch (table_layout) {
+            case layout::node4:
+                return count ? static_cast<node4*>(table)->children[0] : nullptr;
+            case layout::node16:
+                return count ? static_cast<node16*>(table)->children[0] : nullptr;
+            case layout::node48:
+            case layout::node256:
+                return find_from(0);
+            default:
+                return nullptr;
+        }
+    }
+
+    template <typename Node>
+    Node* radix_tree_children<Node>::next(const unit_type unit) const noexcept {
+        // first child whose unit is greater than `unit`
+        switch (table_layout) {
+            case layout::node4:
+                return next_sorted(static_cast<node4*>(table), count, unit);
+            case layout::node16:
+                return next_sorted(static_cast<node16*>(table), count, unit);
+            case layout::node48:
+            case layout::node256:
+                return find_from(unit + 1u);
+            default:
+                return nullptr;
+        }
+    }
+
+    template <typename Node>
+    template <typename Alloc>
+    void radix_tree_children<Node>::insert(const unit_type unit, Node* child, Alloc& alloc) {
+        // the caller guarantees that `unit` is not in the table yet
+        grow(alloc);
+
+        switch (table_layout) {
+            case layout::node4:
+                insert_sorted(static_cast<node4*>(table), count, unit, child);
+                break;
+            case layout::node16:
+                insert_sorted(static_cast<node16*>(table), count, unit, child);
+                break;
+            case layout::node48: {
+                // children of node48 are kept packed, so the next free slot is `count`
+                auto node = static_cast<node48*>(table);
+                node->children[count] = child;
+                node->index[unit] = static_cast<std::uint8_t>(count + 1);
+                node->present.set(unit);
+                break;
+            }
+            case layout::node256: {
+                auto node = static_cast<node256*>(table);
+                node->children[unit] = child;
+                node->present.set(unit);
+                break;
+            }
+            default:
+                break;
+        }
+
+        ++count;
+    }
+
+    template <typename Node>
+    template <typename Alloc>
+    void radix_tree_children<Node>::reserve(const size_type child_count, Alloc& alloc) {
+        // an empty table starts out in the layout that holds child_count children, so filling it never grows it
+        if (table_layout != layout::none || child_count == 0) {
+            return;
+        }
+
+        if (child_count <= 4) {
+            table = allocate_table<node4>(alloc);
+            table_layout = layout::node4;
+        } else if (child_count <= 16) {
+            table = allocate_table<node16>(alloc);
+            table_layout = layout::node16;
+        } else if (child_count <= 48) {
+            table = allocate_table<node48>(alloc);
+            table_layout = layout::node48;
+        } else {
+            table = allocate_table<node256>(alloc);
+            table_layout = layout::node256;
+        }
+    }
+
+    template <typename Node>
+    inline void radix_tree_children<Node>::replace(const unit_type unit, Node* child) noexcept {
+        Node** slot = find_slot(unit);
+        if (slot) {
+            *slot = child;
+        }
+    }
+
+    template <typename Node>
+    template <typename Alloc>
+    void radix_tree_children<Node>::erase(const unit_type unit, Alloc& alloc) noexcept {
+        if (find_slot(unit) == nullptr) {
+            return;
+        }
+
+        switch (table_layout) {
+            case layout::node4:
+                erase_sorted(static_cast<node4*>(table), count, unit);
+                break;
+            case layout::node16:
+                erase_sorted(static_cast<node16*>(table), count, unit);
+                break;
+            case layout::node48: {
+                // move the last child into the hole to keep the children packed
+                auto node = static_cast<node48*>(table);
+                std::uint8_t slot = node->index[unit];
+                node->index[unit] = 0;
+                node->present.reset(unit);
+                if (slot != count) {
+                    node->children[slot - 1] = node->children[count - 1];
+                    for (size_type i = 0; i < 256; ++i) {
+                        if (node->index[i] == count) {
+                            node->index[i] = slot;
+                            break;
+                        }
+                    }
+                }
+                node->children[count - 1] = nullptr;
+                break;
+            }
+            case layout::node256: {
+                auto node = static_cast<node256*>(table);
+                node->children[unit] = nullptr;
+                node->present.reset(unit);
+                break;
+            }
+            default:
+                break;
+        }
+
+        --count;
+        shrink(alloc);
+    }
+
+    template <typename Node>
+    template <typename Visitor>
+    void radix_tree_children<Node>::for_each(Visitor visitor) const {
+        switch (table_layout) {
+            case layout::node4: {
+                auto node = static_cast<node4*>(table);
+                for (size_type i = 0; i < count; ++i) {
+                    visitor(node->units[i], node->children[i]);
+                }
+                break;
+            }
+            case layout::node16: {
+                auto node = static_cast<node16*>(table);
+                for (size_type i = 0; i < count; ++i) {
+                    visitor(node->units[i], node->children[i]);
+                }
+                break;
+            }
+            case layout::node48: {
+                auto node = static_cast<node48*>(table);
+                for (size_type unit = 0; unit < 256; ++unit) {
+                    if (node->index[unit]) {
+                        visitor(static_cast<unit_type>(unit), node->children[node->index[unit] - 1]);
+                    }
+                }
+                break;
+            }
+            case layout::node256: {
+                auto node = static_cast<node256*>(table);
+                for (size_type unit = 0; unit < 256; ++unit) {
+                    if (node->children[unit]) {
+                        visitor(static_cast<unit_type>(unit), node->children[unit]);
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    template <typename Node>
+    template <typename Alloc>
+    void radix_tree_children<Node>::grow(Alloc& alloc) {
+        switch (table_layout) {
+            case layout::none:
+                table = allocate_table<node4>(alloc);
+                table_layout = layout::node4;
+                break;
+            case layout::node4: {
+                if (count < 4) {
+                    break;
+                }
+                auto old_node = static_cast<node4*>(table);
+                auto new_node = allocate_table<node16>(alloc);
+                for (size_type i = 0; i < count; ++i) {
+                    new_node->units[i] = old_node->units[i];
+                    new_node->children[i] = old_node->children[i];
+                }
+                deallocate_table<std::remove_pointer_t<decltype(old_node)>>(old_node, alloc);
+                table = new_node;
+                table_layout = layout::node16;
+                break;
+            }
+            case layout::node16: {
+                if (count < 16) {
+                    break;
+                }
+                auto old_node = static_cast<node16*>(table);
+                auto new_node = allocate_table<node48>(alloc);
+                for (size_type i = 0; i < count; ++i) {
+                    new_node->index[old_node->units[i]] = static_cast<std::uint8_t>(i + 1);
+                    new_node->children[i] = old_node->children[i];
+                    new_node->present.set(old_node->units[i]);
+                }
+                deallocate_table<std::remove_pointer_t<decltype(old_node)>>(old_node, alloc);
+                table = new_node;
+                table_layout = layout::node48;
+                break;
+            }
+            case layout::node48: {
+                if (count < 48) {
+                    break;
+                }
+                auto old_node = static_cast<node48*>(table);
+                auto new_node = allocate_table<node256>(alloc);
+                new_node->present = old_node->present;
+                for (size_type unit = 0; unit < 256; ++unit) {
+                    if (old_node->index[unit]) {
+                        new_node->children[unit] = old_node->children[old_node->index[unit] - 1];
+                    }
+                }
+                deallocate_table<std::remove_pointer_t<decltype(old_node)>>(old_node, alloc);
+                table = new_node;
+                table_layout = layout::node256;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    template <typename Node>
+    template <typename Alloc>
+    void radix_tree_children<Node>::shrink(Alloc& alloc) noexcept {
+        /**
+         * Shrink a bit below the grow threshold so that alternating insert/erase does not thrash. Best effort: the
+         * larger table holds fewer children just as well, so if the smaller one cannot be allocated the table stays
+         * as it is and erase() never fails.
+         */
+        switch (table_layout) {
+            case layout::node4:
+                if (count == 0) {
+                    clear(alloc);
+                }
+                break;
+            case layout::node16: {
+                if (count > 3) {
+                    break;
+                }
+                auto old_node = static_cast<node16*>(table);
+                auto new_node = try_allocate_table<node4>(alloc);
+                if (new_node == nullptr) {
+                    break;
+                }
+                for (size_type i = 0; i < count; ++i) {
+                    new_node->units[i] = old_node->units[i];
+                    new_node->children[i] = old_node->children[i];
+                }
+                deallocate_table<std::remove_pointer_t<decltype(old_node)>>(old_node, alloc);
+                table = new_node;
+                table_layout = layout::node4;
+                break;
+            }
+            case layout::node48: {
+                if (count > 12) {
+                    break;
+                }
+                auto old_node = static_cast<node48*>(table);
+                auto new_node = try_allocate_table<node16>(alloc);
+                if (new_node == nullptr) {
+                    break;
+                }
+                size_type i = 0;
+                for (size_type unit = 0; unit < 256; ++unit) {
+                    if (old_node->index[unit]) {
+                        new_node->units[i] = static_cast<unit_type>(unit);
+                        new_node->children[i++] = old_node->children[old_node->index[unit] - 1];
+                    }
+                }
+                deallocate_table<std::remove_pointer_t<decltype(old_node)>>(old_node, alloc);
+                table = new_node;
+                table_layout = layout::node16;
+                break;
+            }
+            case layout::node256: {
+                if (count > 36) {
+                    break;
+                }
+                auto old_node = static_cast<node256*>(table);
+                auto new_node = try_allocate_table<node48>(alloc);
+                if (new_node == nullptr) {
+                    break;
+                }
+                new_node->present = old_node->present;
+                size_type slot = 0;
+                for (size_type unit = 0; unit < 256; ++unit) {
+                    if (old_node->children[unit]) {
+                        new_node->children[slot] = old_node->children[unit];
+                        new_node->index[unit] = static_cast<std::uint8_t>(++slot);
+                    }
+                }
+                deallocate_table<std::remove_pointer_t<decltype(old_node)>>(old_node, alloc);
+                table = new_node;
+                table_layout = layout::node48;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    template <typename Node>
+    template <typename Alloc>
+    void radix_tree_children<Node>::clear(Alloc& alloc) noexcept {
+        switch (table_layout) {
+            case layout::node4:
+                deallocate_table<node4>(table, alloc);
+                break;
+            case layout::node16:
+                deallocate_table<node16>(table, alloc);
+                break;
+            case layout::node48:
+                deallocate_table<node48>(table, alloc);
+                break;
+            case layout::node256:
+                deallocate_table<node256>(table, alloc);
+                break;
+            default:
+                break;
+        }
+
+        table = nullptr;
+        table_layout = layout::none;
+        count = 0;
+    }
+}
+
+#endif //PHAM_PHI_LONG_RADIX_TREE_CHILDREN_H
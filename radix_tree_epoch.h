@@ -0,0 +1,203 @@
+//
+// Epoch based memory reclamation for concurrent_radix_tree.
+//
+
+#ifndef PHAM_PHI_LONG_RADIX_TREE_EPOCH_H
+#define PHAM_PHI_LONG_RADIX_TREE_EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace phamphilong {
+    /**
+     * Read:
+     *      https://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf
+     * for the scheme.
+     *
+     * Every operation on a concurrent tree runs inside a guard, which announces the global epoch the thread entered
+     * with. A writer unlinks an object and retires it with the epoch current at that time, the object is freed once the
+     * global epoch is two steps further: by then every thread that could still see it has left its guard. The global
+     * epoch only moves when all threads inside a guard have announced the current one.
+     *
+     * One process wide instance serves all trees, objects are retired together with the function that frees them.
+     * A thread only holds an announcement slot while it is inside a guard, so any number of threads can use the trees
+     * as long as at most max_threads are inside one at the same time; retired objects stay with the thread, not
+     * with the slot.
+     */
+    class radix_tree_epoch {
+    public:
+        using size_type = std::size_t;
+        using deleter_type = void (*)(void*);
+
+        class guard {
+        public:
+            guard() {
+                radix_tree_epoch::instance().enter();
+            }
+
+            guard(const guard&) = delete;
+            guard& operator= (const guard&) = delete;
+
+            ~guard() {
+                radix_tree_epoch::instance().exit();
+            }
+        };
+
+        static radix_tree_epoch& instance() {
+            static radix_tree_epoch epoch;
+            return epoch;
+        }
+
+        radix_tree_epoch(const radix_tree_epoch&) = delete;
+        radix_tree_epoch& operator= (const radix_tree_epoch&) = delete;
+        ~radix_tree_epoch();
+
+        void retire(void* object, deleter_type deleter);
+
+    private:
+        static constexpr size_type max_threads = 256;
+        static constexpr size_type collect_interval = 64;
+
+        struct alignas(64) thread_slot {
+            std::atomic<std::uint64_t> state{0};        // (epoch << 1) | 1 while inside a guard, 0 outside
+            std::atomic<bool> used{false};
+        };
+
+        struct retired_object {
+            void* object;
+            deleter_type deleter;
+            std::uint64_t epoch;
+        };
+
+        struct thread_state {
+            thread_slot* slot{nullptr};                 // held while nesting > 0, else the one to try first
+            size_type nesting{0};
+            size_type retire_count{0};
+            std::vector<retired_object> retired{};
+
+            ~thread_state() {
+                radix_tree_epoch::instance().leave_thread(*this);
+            }
+        };
+
+        radix_tree_epoch() = default;
+
+        std::atomic<std::uint64_t> global_epoch{1};
+        thread_slot slots[max_threads]{};
+        std::mutex orphans_mutex{};
+        std::vector<retired_object> orphans{};          // retired by threads that have exited
+        std::atomic<bool> has_orphans{false};
+
+        static thread_state& local_state() {
+            thread_local thread_state state;
+            return state;
+        }
+
+        void enter();
+        void exit() noexcept;
+        thread_slot* acquire_slot(thread_slot* preferred_slot);
+        void try_advance() noexcept;
+        void collect(std::vector<retired_object>& retired) noexcept;
+        void leave_thread(thread_state& state);
+    };
+
+    inline radix_tree_epoch::~radix_tree_epoch() {
+        // process exit, no guard is active anymore
+        for (auto& retired : orphans) {
+            retired.deleter(retired.object);
+        }
+    }
+
+    inline void radix_tree_epoch::enter() {
+        thread_state& state = local_state();
+        if (state.nesting++ > 0) {
+            return;
+        }
+
+        state.slot = acquire_slot(state.slot);
+        state.slot->state.store((global_epoch.load(std::memory_order_relaxed) << 1) | 1, std::memory_order_seq_cst);
+    }
+
+    inline void radix_tree_epoch::exit() noexcept {
+        thread_state& state = local_state();
+        if (--state.nesting == 0) {
+            state.slot->state.store(0, std::memory_order_release);
+            state.slot->used.store(false, std::memory_order_release);
+        }
+    }
+
+    inline radix_tree_epoch::thread_slot* radix_tree_epoch::acquire_slot(thread_slot* preferred_slot) {
+        // the slot the thread held last is usually still free, and still in its cache
+        auto try_acquire = [](thread_slot& slot) {
+            bool used = false;
+            return !slot.used.load(std::memory_order_relaxed) && slot.used.compare_exchange_strong(used, true, std::memory_order_acquire);
+        };
+        if (preferred_slot != nullptr && try_acquire(*preferred_slot)) {
+            return preferred_slot;
+        }
+
+        for (;;) {
+            for (auto& slot : slots) {
+                if (try_acquire(slot)) {
+                    return &slot;
+                }
+            }
+
+            // more than max_threads threads inside a guard at the same time, wait for one to exit
+            std::this_thread::yield();
+        }
+    }
+
+    inline void radix_tree_epoch::retire(void* object, deleter_type deleter) {
+        thread_state& state = local_state();
+        state.retired.push_back(retired_object{object, deleter, global_epoch.load(std::memory_order_seq_cst)});
+        if (++state.retire_count % collect_interval == 0) {
+            try_advance();
+            collect(state.retired);
+            if (has_orphans.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock{orphans_mutex};
+                collect(orphans);
+                has_orphans.store(!orphans.empty(), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    inline void radix_tree_epoch::try_advance() noexcept {
+        std::uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+        for (auto& slot : slots) {
+            std::uint64_t slot_state = slot.state.load(std::memory_order_seq_cst);
+            if ((slot_state & 1) && (slot_state >> 1) != epoch) {
+                return;     // a thread is still inside a guard of an older epoch
+            }
+        }
+        global_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+    }
+
+    inline void radix_tree_epoch::collect(std::vector<retired_object>& retired) noexcept {
+        std::uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+        size_type kept = 0;
+        for (auto& object : retired) {
+            if (object.epoch + 2 <= epoch) {
+                object.deleter(object.object);
+            } else {
+                retired[kept++] = object;
+            }
+        }
+        retired.resize(kept);
+    }
+
+    inline void radix_tree_epoch::leave_thread(thread_state& state) {
+        if (!state.retired.empty()) {
+            std::lock_guard<std::mutex> lock{orphans_mutex};
+            orphans.insert(orphans.end(), state.retired.begin(), state.retired.end());
+            has_orphans.store(true, std::memory_order_relaxed);
+        }
+        // the slot was given back by the last exit(), another thread may hold it by now
+    }
+}
+
+#endif //PHAM_PHI_LONG_RADIX_TREE_EPOCH_H
@@ -0,0 +1,146 @@
+//
+// Key customization points for integer keys.
+//
+
+#ifndef PHAM_PHI_LONG_RADIX_TREE_INTEGER_KEY_H
+#define PHAM_PHI_LONG_RADIX_TREE_INTEGER_KEY_H
+
+#include "radix_tree_node.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace phamphilong {
+    /**
+     * Big-endian bytes of an integer, or a run of them, held by value. The most significant byte comes first, so
+     * the byte order of the tree is the numeric order; the sign bit of signed integers is flipped so that negative
+     * numbers come first.
+     *
+     *      radix_tree<std::uint32_t, route> routes;
+     *      routes.insert({0xC0A80001, route{...}});        // units C0 A8 00 01
+     *
+     * Converting from and to the integer is unrolled into shifts and masks, and every key is sizeof(Int) units long.
+     */
+    template <typename Int>
+    class radix_integer_view {
+    public:
+        using value_type = char;
+        using size_type = std::size_t;
+
+        static constexpr size_type npos = static_cast<size_type>(-1);
+        static constexpr size_type max_size = sizeof(Int);
+
+        constexpr radix_integer_view() noexcept = default;
+
+        constexpr radix_integer_view(const Int key) noexcept : len{max_size} {
+            unsigned_type bits = static_cast<unsigned_type>(key) ^ sign_bit;
+            for (size_type i = 0; i < max_size; ++i) {
+                units[i] = static_cast<value_type>(static_cast<unsigned char>(bits >> (8 * (max_size - 1 - i))));
+            }
+        }
+
+        constexpr radix_integer_view(const value_type* key_units, const size_type count) noexcept
+                : len{static_cast<std::uint8_t>(count)} {
+            for (size_type i = 0; i < count; ++i) {
+                units[i] = key_units[i];
+            }
+        }
+
+        explicit constexpr operator Int() const noexcept {
+            // only meaningful for a whole key
+            unsigned_type bits = 0;
+            for (size_type i = 0; i < max_size; ++i) {
+                bits = static_cast<unsigned_type>((bits << 8) | static_cast<unsigned char>(units[i]));
+            }
+            return static_cast<Int>(bits ^ sign_bit);
+        }
+
+        constexpr const value_type* data() const noexcept {
+            return units;
+        }
+
+        constexpr size_type size() const noexcept {
+            // never more than max_size, saying so lets the compiler bound copies of the units
+            return len < max_size ? len : max_size;
+        }
+
+        constexpr value_type operator[] (const size_type pos) const noexcept {
+            return units[pos];
+        }
+
+        constexpr radix_integer_view substr(const size_type start, const size_type count = npos) const noexcept {
+            // like std::string_view::substr, but a start past the end gives an empty view instead of throwing
+            size_type first = start < len ? start : len;
+            size_type rest = len - first;
+            return radix_integer_view(units + first, count < rest ? count : rest);
+        }
+
+        friend constexpr bool operator== (const radix_integer_view& lhs, const radix_integer_view& rhs) noexcept {
+            if (lhs.len != rhs.len) {
+                return false;
+            }
+            for (size_type i = 0; i < lhs.len; ++i) {
+                if (lhs.units[i] != rhs.units[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        friend constexpr bool operator!= (const radix_integer_view& lhs, const radix_integer_view& rhs) noexcept {
+            return !(lhs == rhs);
+        }
+
+    private:
+        using unsigned_type = std::make_unsigned_t<Int>;
+
+        static constexpr unsigned_type sign_bit = std::is_signed<Int>::value ? static_cast<unsigned_type>(unsigned_type{1} << (8 * max_size - 1)) : 0;
+
+        value_type units[max_size]{};
+        std::uint8_t len{0};
+    };
+
+    template <typename Int>
+    struct integer_split {
+        using view_type = radix_integer_view<Int>;
+
+        constexpr view_type operator()(view_type key, std::size_t start, std::size_t len) const noexcept {
+            return key.substr(start, len);
+        }
+
+        constexpr view_type operator()(view_type key, std::size_t start) const noexcept {
+            return key.substr(start);
+        }
+    };
+
+    template <typename Int>
+    struct integer_radix_len {
+        constexpr std::size_t operator()(radix_integer_view<Int> key) const noexcept {
+            return key.size();
+        }
+    };
+
+    template <> struct split<signed char> : integer_split<signed char> {};
+    template <> struct split<unsigned char> : integer_split<unsigned char> {};
+    template <> struct split<short> : integer_split<short> {};
+    template <> struct split<unsigned short> : integer_split<unsigned short> {};
+    template <> struct split<int> : integer_split<int> {};
+    template <> struct split<unsigned int> : integer_split<unsigned int> {};
+    template <> struct split<long> : integer_split<long> {};
+    template <> struct split<unsigned long> : integer_split<unsigned long> {};
+    template <> struct split<long long> : integer_split<long long> {};
+    template <> struct split<unsigned long long> : integer_split<unsigned long long> {};
+
+    template <> struct radix_len<signed char> : integer_radix_len<signed char> {};
+    template <> struct radix_len<unsigned char> : integer_radix_len<unsigned char> {};
+    template <> struct radix_len<short> : integer_radix_len<short> {};
+    template <> struct radix_len<unsigned short> : integer_radix_len<unsigned short> {};
+    template <> struct radix_len<int> : integer_radix_len<int> {};
+    template <> struct radix_len<unsigned int> : integer_radix_len<unsigned int> {};
+    template <> struct radix_len<long> : integer_radix_len<long> {};
+    template <> struct radix_len<unsigned long> : integer_radix_len<unsigned long> {};
+    template <> struct radix_len<long long> : integer_radix_len<long long> {};
+    template <> struct radix_len<unsigned long long> : integer_radix_len<unsigned long long> {};
+}
+
+#endif //PHAM_PHI_LONG_RADIX_TREE_INTEGER_KEY_H
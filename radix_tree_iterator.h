@@ -6,11 +6,19 @@
 #define PHAM_PHI_LONG_RADIX_TREE_ITERATOR_H
 
 #include "radix_tree_node.h"
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 
 namespace phamphilong {
+    /**
+     * Nodes do not store their keys, so dereferencing yields a proxy pair of references: the key is rebuilt from the
+     * edge labels on the path the first time it is asked for, then kept in the iterator and patched as it moves.
+     */
     template <typename Key, typename T, typename Split, typename Len>
     class radix_tree_iterator {
-        friend class radix_tree<Key, T, Split, Len>;
+        template <typename, typename, typename, typename, typename> friend class radix_tree;
 
     public:
         using mapped_type = T;
@@ -18,66 +26,140 @@ namespace phamphilong {
         using iterator = radix_tree_iterator<key_type, mapped_type, Split, Len>;
         using node_type = radix_tree_node<key_type , mapped_type , Split, Len>;
         using value_type = std::pair<const key_type , mapped_type>;
+        using reference = std::pair<const key_type&, mapped_type&>;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
 
-        value_type& operator* () const;
-        value_type* operator-> () const;
+        struct pointer {
+            reference ref;
+
+            reference* operator-> () {
+                return &ref;
+            }
+        };
+
+        radix_tree_iterator() = default;
+
+        reference operator* () const;
+        pointer operator-> () const;
+        const key_type& key() const;
+        mapped_type& value() const;
         const iterator& operator++ ();
         iterator operator++ (int);
         bool operator!= (const iterator& lhs) const;
         bool operator== (const iterator& lhs) const;
 
     private:
+        using key_view_type = typename node_type::key_view_type;
+        using char_type = typename node_type::char_type;
+
         radix_tree_iterator(node_type * pointed_node) : pointed_node{pointed_node} {}
-        node_type * pointed_node;
+        node_type * pointed_node{nullptr};
+        mutable key_type cached_key{};
+        mutable bool key_cached{false};
+
+        void extend_cached_key(const node_type* node);
     };
 
     template <typename Key, typename T, typename Split, typename Len>
-    inline typename radix_tree_iterator<Key, T, Split, Len>::value_type& radix_tree_iterator<Key, T, Split, Len>::operator* () const {
-        return *pointed_node->value;
+    inline typename radix_tree_iterator<Key, T, Split, Len>::reference radix_tree_iterator<Key, T, Split, Len>::operator* () const {
+        return reference{key(), *pointed_node->value};
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    inline typename radix_tree_iterator<Key, T, Split, Len>::pointer radix_tree_iterator<Key, T, Split, Len>::operator-> () const {
+        return pointer{**this};
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    const typename radix_tree_iterator<Key, T, Split, Len>::key_type& radix_tree_iterator<Key, T, Split, Len>::key() const {
+        if (key_cached) {
+            return cached_key;
+        }
+
+        // walk up to the root, writing every edge label in front of the ones below it
+        auto fill_key = [this](std::basic_string<char_type>& units) {
+            units.resize(pointed_node->depth);
+            for (const node_type* node = pointed_node; !node->is_root(); node = node->parent_node) {
+                std::memcpy(&units[node->depth - node->label_len], node->label_data(), node->label_len * sizeof(char_type));
+            }
+        };
+
+        if constexpr (std::is_same<key_type, std::basic_string<char_type>>::value) {
+            // reuse the capacity of the previous key
+            fill_key(cached_key);
+        } else {
+            std::basic_string<char_type> units;
+            fill_key(units);
+            cached_key = key_type{key_view_type(units.data(), units.size())};
+        }
+        key_cached = true;
+        return cached_key;
     }
 
     template <typename Key, typename T, typename Split, typename Len>
-    inline typename radix_tree_iterator<Key, T, Split, Len>::value_type* radix_tree_iterator<Key, T, Split, Len>::operator-> () const {
-        return pointed_node->value.get();
+    inline typename radix_tree_iterator<Key, T, Split, Len>::mapped_type& radix_tree_iterator<Key, T, Split, Len>::value() const {
+        return *pointed_node->value;
     }
 
     template <typename Key, typename T, typename Split, typename Len>
     const typename radix_tree_iterator<Key, T, Split, Len>::iterator& radix_tree_iterator<Key, T, Split, Len>::operator++ () {
-        // find first children node
-        auto child_it = pointed_node->children.begin();
-        if (child_it != pointed_node->children.end()) {
-            pointed_node = child_it->second;
+        /**
+         * Pre-order walk without recursion nor allocation: go to the first child, or else to the next sibling of the
+         * nearest ancestor that has one. A node without a value always has children, so going down the first
+         * children from there ends on a value. Children tables are indexed by unit, finding a sibling is a table
+         * lookup, so a full scan costs amortized O(1) per step.
+         */
+        node_type* node = pointed_node;
+        node_type* child_node = node->children.first();
+        if (child_node != nullptr) {
+            node = child_node;
         } else {
             // cannot find any children, then find sibling
-            auto parent_node = pointed_node->parent_node;
-            while (parent_node != nullptr) {
-                auto it = pointed_node->parent_node->children.find(pointed_node->get_search_key());
-                if (it != pointed_node->parent_node->children.end()) {
-                    ++it;
-                    if (it != pointed_node->parent_node->children.end()) {
-                        // found a sibling, jump to it
-                        pointed_node = it->second;
-                        break;
-                    }
-                } else {
-                    // something wrong here, it's impossible in theory
+            for (;;) {
+                node_type* parent_node = node->parent_node;
+                if (parent_node == nullptr) {
+                    // already reached final node
+                    pointed_node = nullptr;
+                    key_cached = false;
+                    return *this;
+                }
+
+                node_type* sibling_node = parent_node->children.next(node->get_search_unit());
+                if (sibling_node != nullptr) {
+                    // found a sibling, jump to it
+                    node = sibling_node;
                     break;
                 }
 
                 // there is no sibling, then go upward
-                pointed_node = parent_node;
-                parent_node = pointed_node->parent_node;
+                node = parent_node;
             }
         }
 
-        if (pointed_node->parent_node == nullptr) {
-            // already reached final node
-            this->pointed_node = nullptr;
-            return *this;
-        } else if (pointed_node->is_leaf()) {
-            return *this;
+        extend_cached_key(node);
+        while (!node->has_value()) {
+            node = node->children.first();
+            extend_cached_key(node);
+        }
+
+        pointed_node = node;
+        return *this;
+    }
+
+    template <typename Key, typename T, typename Split, typename Len>
+    inline void radix_tree_iterator<Key, T, Split, Len>::extend_cached_key(const node_type* node) {
+        // the parent of every node the walk moves to lies on the current path, so a key built by key() is kept up to
+        // date by cutting it at the parent and appending the edge label, instead of being rebuilt from the root
+        if (!key_cached) {
+            return;
+        }
+
+        if constexpr (std::is_same<key_type, std::basic_string<char_type>>::value) {
+            cached_key.resize(node->depth - node->label_len);
+            cached_key.append(node->label_data(), node->label_len);
         } else {
-            return this->operator++();
+            key_cached = false;
         }
     }
 
@@ -97,6 +179,42 @@ namespace phamphilong {
     inline bool radix_tree_iterator<Key, T, Split, Len>::operator== (const iterator& lhs) const {
         return pointed_node == lhs.pointed_node;
     }
+
+    /**
+     * A [begin, end) pair of tree iterators, e.g. the keys sharing a prefix. It does not own anything and stays
+     * valid as long as the tree is not modified.
+     */
+    template <typename Iterator>
+    class radix_tree_range {
+    public:
+        using iterator = Iterator;
+
+        radix_tree_range() = default;
+        radix_tree_range(iterator first, iterator last) : first{std::move(first)}, last{std::move(last)} {}
+
+        iterator begin() const {
+            return first;
+        }
+
+        iterator end() const {
+            return last;
+        }
+
+        bool empty() const {
+            return first == last;
+        }
+
+    private:
+        iterator first{};
+        iterator last{};
+    };
+
+    // an entry found by radix_tree::find_fuzzy, distance is the edit distance of its key to the searched key
+    template <typename Iterator>
+    struct radix_tree_fuzzy_match {
+        Iterator position;
+        std::size_t distance;
+    };
 }
 
 #endif //PHAM_PHI_LONG_RADIX_TREE_ITERATOR_H
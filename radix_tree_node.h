@@ -5,77 +5,182 @@
 #ifndef PHAM_PHI_LONG_RADIX_TREE_NODE_H
 #define PHAM_PHI_LONG_RADIX_TREE_NODE_H
 
-#include <unordered_map>
+#include "radix_tree_children.h"
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace phamphilong {
     template <typename Key> struct split;
     template <typename Key> struct radix_len;
 
+    /**
+     * Key customization points. Both work on a non-owning view of the key, so walking the tree never copies a key:
+     *      split<Key>::view_type : cheap to copy view of a key, constructible from (const value_type*, length),
+     *                              Key must be constructible from it, value_type is a one byte unit
+     *      split<Key>            : returns a sub view of a key view
+     *      radix_len<Key>        : returns the number of units of a key view
+     */
     template <>
     struct split<std::string> {
-        std::string operator()(const std::string& key, std::size_t start, std::size_t len) const {
+        using view_type = std::string_view;
+
+        view_type operator()(view_type key, std::size_t start, std::size_t len) const {
             return key.substr(start, len);
         }
 
-        std::string operator()(const std::string& key, std::size_t start) const {
+        view_type operator()(view_type key, std::size_t start) const {
             return key.substr(start);
         }
     };
 
     template <>
     struct radix_len<std::string> {
-         std::size_t operator()(const std::string& key) const {
+        std::size_t operator()(std::string_view key) const {
             return key.length();
         }
     };
 
-    template <typename Key, typename T, typename Split, typename Len> class radix_tree;
+    /**
+     * Score customization point, for values that carry a score, e.g. the popularity of an autocomplete entry:
+     *      radix_score<T>::score_type   : arithmetic type of the scores
+     *      radix_score<T>::get(value)   : score of value
+     *
+     * With it every node caches the highest score in its subtree, which radix_tree::top_k_with_prefix() prunes with.
+     * The primary template gives values no score, their nodes keep no cache.
+     *
+     *      template <>
+     *      struct radix_score<entry> {
+     *          using score_type = std::uint32_t;
+     *          static score_type get(const entry& value) { return value.popularity; }
+     *      };
+     */
+    template <typename T, typename Enable = void>
+    struct radix_score {};
+
+    // base of radix_tree_node, empty unless T has a score so that other nodes keep their size
+    template <typename T, typename Enable = void>
+    class radix_tree_node_score {
+    public:
+        static constexpr bool enabled = false;
+    };
+
+    template <typename T>
+    class radix_tree_node_score<T, std::void_t<typename radix_score<T>::score_type>> {
+    public:
+        using score_type = typename radix_score<T>::score_type;
+        static_assert(std::is_arithmetic<score_type>::value, "radix_score<T>::score_type must be arithmetic");
+
+        static constexpr bool enabled = true;
+
+    protected:
+        score_type max_score{std::numeric_limits<score_type>::lowest()};       // lowest while the subtree is empty
+    };
+
+    /**
+     * Subtree count customization point, for trees that need count_with_prefix(), rank() and select():
+     *      radix_subtree_count<T>::value  : true if the nodes of trees holding T values count their subtree
+     *
+     * With it every node counts the values in its subtree, nodes grow from 64 to 72 bytes. Like radix_score<T> it is
+     * a property of the value type, so every tree type has one node layout in the whole program.
+     *
+     *      template <>
+     *      struct radix_subtree_count<entry> : std::true_type {};
+     */
+    template <typename T, typename Enable = void>
+    struct radix_subtree_count : std::false_type {};
+
+    // base of radix_tree_node, empty unless T values are counted so that other nodes keep their size
+    template <typename T, bool = radix_subtree_count<T>::value>
+    class radix_tree_node_count {
+    public:
+        static constexpr bool enabled = false;
+    };
+
+    template <typename T>
+    class radix_tree_node_count<T, true> {
+    public:
+        static constexpr bool enabled = true;
+
+    protected:
+        std::size_t subtree_count{0};                   // values in the subtree of this node, its own included
+    };
+
+    template <typename Key, typename T, typename Split, typename Len, typename Allocator> class radix_tree;
     template <typename Key, typename T, typename Split, typename Len> class radix_tree_iterator;
+    template <typename Key, typename T, typename Split, typename Len> class frozen_radix_tree;
+    struct radix_tree_parallel;
 
     template <typename Key, typename T, typename Split, typename Len>
-    class radix_tree_node {
-        friend class radix_tree<Key, T, Split, Len>;
+    class radix_tree_node : public radix_tree_node_score<T>, public radix_tree_node_count<T> {
+        template <typename, typename, typename, typename, typename> friend class radix_tree;
         friend class radix_tree_iterator<Key, T, Split, Len>;
+        friend class frozen_radix_tree<Key, T, Split, Len>;
+        friend struct radix_tree_parallel;
 
     private:
         using mapped_type = T;
         using key_type = Key;
+        using key_view_type = typename Split::view_type;
+        using char_type = typename key_view_type::value_type;
+        static_assert(sizeof(char_type) == 1, "children are indexed by one byte units, keys of wider units would share slots");
         using iterator = radix_tree_iterator<key_type, mapped_type, Split, Len>;
         using node_type = radix_tree_node<key_type , mapped_type , Split, Len>;
-        using value_type = std::pair<const key_type , mapped_type>;
         using size_type = std::size_t;
+        using children_type = radix_tree_children<radix_tree_node>;
+        using unit_type = typename children_type::unit_type;
+
+        /**
+         * A node only keeps the edge label from its parent, the key of a node is the concatenation of the labels on
+         * its path. Labels up to inline_label_capacity units live inside the node, longer ones are allocated by the
+         * tree. Nodes are trivially destructible, the tree frees labels, values and child tables.
+         */
+        static constexpr size_type inline_label_capacity = 24 / sizeof(char_type);
 
-        radix_tree_node(value_type value, radix_tree_node* parent_node, const size_type depth)
-                : value{new value_type(value)}, parent_node{parent_node}, depth{depth} {}
+        radix_tree_node(radix_tree_node* parent_node, const size_type depth)
+                : parent_node{parent_node}, depth{static_cast<std::uint32_t>(depth)} {}
 
-        const Split split_key{};
-        std::unique_ptr<value_type> value{nullptr};
         radix_tree_node* parent_node{nullptr};
-        size_type depth{0};
-        std::unordered_map<key_type, radix_tree_node<key_type, T, Split, Len>*> children{};
+        mapped_type* value{nullptr};                    // only set if a key ends at this node
+        children_type children{};
+        std::uint32_t depth{0};                         // length of the key up to the end of this node
+        std::uint32_t label_len{0};
+        union {
+            char_type inline_label[inline_label_capacity];
+            char_type* heap_label;
+        };
+
+        bool has_value() const {
+            return value != nullptr;
+        }
 
-        bool is_leaf() {
+        bool is_leaf() const {
             return children.empty();
         }
 
-        bool is_root() {
+        bool is_root() const {
             return nullptr == parent_node;
         }
 
-        key_type get_search_key() {
-            // return the key of this node in parent's children map
-            if (is_root()) {
-                return split_key(value->first, 0, depth);
-            }
+        bool has_inline_label() const {
+            return label_len <= inline_label_capacity;
+        }
+
+        const char_type* label_data() const {
+            return has_inline_label() ? inline_label : heap_label;
+        }
 
-            return split_key(value->first, parent_node->depth, depth);
+        key_view_type get_search_key() const {
+            // return the edge label of this node
+            return key_view_type(label_data(), label_len);
         }
 
-        ~radix_tree_node() {
-            for (auto& child : children) {
-                delete child.second;
-            }
+        unit_type get_search_unit() const {
+            // return the unit this node is indexed by in parent's children table
+            return static_cast<unit_type>(label_data()[0]);
         }
     };
 }
@@ -0,0 +1,447 @@
+//
+// Parallel construction and visitation of a radix tree.
+//
+
+#ifndef PHAM_PHI_LONG_RADIX_TREE_PARALLEL_H
+#define PHAM_PHI_LONG_RADIX_TREE_PARALLEL_H
+
+#include "radix_tree.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace phamphilong {
+    /**
+     * Builds tree from [first, last) like radix_tree::assign, on up to thread_count threads (0 means one per core).
+     *
+     * Sorted input is cut where the keys diverge: after their longest common prefix l, every distinct unit at
+     * position l starts a disjoint range of keys, one subtree of the node that ends at l. The ranges are spread over
+     * the threads, each builds its share bottom-up as a separate tree of the keys with l units cut off, and the
+     * roots of those trees are grafted under the node of the common prefix.
+     *
+     *      https://example.com/a..., https://example.com/b..., https://example.org/...
+     *
+     *      (root)
+     *        |____ (https://example.)              built by the calling thread
+     *                |____ (com/) ...              thread 1
+     *                |____ (org/) ...              thread 2
+     *
+     * Input that is not sorted, or with a single range, is built on the calling thread. So is a tree whose allocator
+     * is not always equal (e.g. radix_tree_pool_allocator, whose pool is not thread safe), since nodes built by a
+     * thread are freed by the tree.
+     */
+    template <typename Tree, typename ForwardIt>
+    void parallel_assign(Tree& tree, ForwardIt first, ForwardIt last, std::size_t thread_count = 0);
+
+    /**
+     * Calls visitor(key, value) for every entry of tree, from up to thread_count threads at once and in no
+     * particular order; key is a key_view_type only valid during the call. The visitor must be safe to call
+     * concurrently, and the tree must not change meanwhile.
+     *
+     * Subtrees are shared out by work stealing: each thread walks its subtree depth first, and while some thread
+     * is idle it moves the shallowest half of its pending nodes to its queue, where idle threads steal from. Large
+     * subtrees are so split as long as there is a thread to take the pieces, and not at all otherwise.
+     */
+    template <typename Tree, typename Visitor>
+    void parallel_for_each(const Tree& tree, Visitor visitor, std::size_t thread_count = 0);
+
+    // parallel_for_each restricted to the keys starting with prefix
+    template <typename Tree, typename Visitor>
+    void parallel_for_each_with_prefix(const Tree& tree, typename Tree::key_view_type prefix, Visitor visitor, std::size_t thread_count = 0);
+
+    struct radix_tree_parallel {
+        template <typename Tree, typename ForwardIt>
+        static void assign(Tree& tree, ForwardIt first, ForwardIt last, std::size_t thread_count);
+
+        template <typename Tree, typename Visitor>
+        static void for_each(const Tree& tree, Visitor& visitor, const std::size_t thread_count) {
+            visit(tree.root_node, visitor, thread_count);
+        }
+
+        template <typename Tree, typename Visitor>
+        static void for_each_with_prefix(const Tree& tree, typename Tree::key_view_type prefix, Visitor& visitor, const std::size_t thread_count) {
+            visit(tree.find_prefix_node(prefix), visitor, thread_count);
+        }
+
+    private:
+        template <typename Node, typename Visitor> class visit_pool;
+
+        template <typename Node, typename Visitor>
+        static void visit(const Node* start_node, Visitor& visitor, std::size_t thread_count);
+
+        static std::size_t default_thread_count(const std::size_t thread_count) noexcept {
+            if (thread_count != 0) {
+                return thread_count;
+            }
+            std::size_t cores = std::thread::hardware_concurrency();
+            return cores != 0 ? cores : 1;
+        }
+
+        template <typename Function>
+        static void run_on_threads(const std::size_t thread_count, Function function) {
+            // function(0) runs on the calling thread, the first exception is rethrown once all threads are done
+            std::vector<std::exception_ptr> errors(thread_count);
+            std::vector<std::thread> threads;
+            auto run = [&function, &errors](const std::size_t index) {
+                try {
+                    function(index);
+                } catch (...) {
+                    errors[index] = std::current_exception();
+                }
+            };
+
+            try {
+                for (std::size_t index = 1; index < thread_count; ++index) {
+                    threads.emplace_back(run, index);
+                }
+            } catch (...) {
+                errors[0] = std::current_exception();
+            }
+            if (!errors[0]) {
+                run(0);
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            for (auto& error : errors) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+
+        template <typename Node>
+        static void shift_depths(Node* root_node, const std::size_t shift) noexcept {
+            // nodes below root_node were built for keys cut by shift units
+            Node* node = root_node->children.first();
+            while (node != nullptr) {
+                node->depth += static_cast<std::uint32_t>(shift);
+                Node* next_node = node->children.first();
+                while (next_node == nullptr && node != root_node) {
+                    next_node = node->parent_node->children.next(node->get_search_unit());
+                    node = node->parent_node;
+                }
+                node = next_node;
+            }
+        }
+    };
+
+    template <typename Node, typename Visitor>
+    class radix_tree_parallel::visit_pool {
+    public:
+        using size_type = std::size_t;
+        using char_type = typename Node::char_type;
+        using key_view_type = typename Node::key_view_type;
+
+        visit_pool(Visitor& visitor, const size_type thread_count) : visitor{visitor}, queues(thread_count) {}
+
+        void push(const size_type index, const Node* node) {
+            pending.fetch_add(1);
+            std::lock_guard<std::mutex> lock{queues[index].mutex};
+            queues[index].nodes.push_back(node);
+        }
+
+        void work(const size_type index) {
+            bool idle = false;
+            while (!failed.load(std::memory_order_relaxed)) {
+                const Node* node = take(index);
+                if (node == nullptr) {
+                    if (pending.load() == 0) {
+                        break;
+                    }
+                    if (!idle) {
+                        idle_count.fetch_add(1);
+                        idle = true;
+                    }
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                if (idle) {
+                    idle_count.fetch_sub(1);
+                    idle = false;
+                }
+                try {
+                    visit_subtree(index, node);
+                } catch (...) {
+                    failed.store(true);
+                    throw;
+                }
+                pending.fetch_sub(1);
+            }
+            if (idle) {
+                idle_count.fetch_sub(1);
+            }
+        }
+
+    private:
+        struct node_queue {
+            std::mutex mutex;
+            std::deque<const Node*> nodes;
+        };
+
+        Visitor& visitor;
+        std::vector<node_queue> queues;
+        std::atomic<size_type> pending{0};          // subtrees queued or being visited
+        std::atomic<size_type> idle_count{0};
+        std::atomic<bool> failed{false};
+
+        const Node* take(const size_type index) {
+            // own queue from the back, the deepest nodes, then steal from the front of the others, the shallowest
+            {
+                node_queue& own = queues[index];
+                std::lock_guard<std::mutex> lock{own.mutex};
+                if (!own.nodes.empty()) {
+                    const Node* node = own.nodes.back();
+                    own.nodes.pop_back();
+                    return node;
+                }
+            }
+            for (size_type i = 1; i < queues.size(); ++i) {
+                node_queue& other = queues[(index + i) % queues.size()];
+                std::lock_guard<std::mutex> lock{other.mutex};
+                if (!other.nodes.empty()) {
+                    const Node* node = other.nodes.front();
+                    other.nodes.pop_front();
+                    return node;
+                }
+            }
+            return nullptr;
+        }
+
+        void visit_subtree(const size_type index, const Node* subtree_node) {
+            /**
+             * Depth first with a stack of pending nodes. The previous node visited is always the parent of the next
+             * one or inside the subtree of an earlier sibling, so the key of the parent is a prefix of `key` and
+             * only the label of the next node has to be written behind it.
+             */
+            std::basic_string<char_type> key(subtree_node->depth, char_type{});
+            for (const Node* node = subtree_node; !node->is_root(); node = node->parent_node) {
+                std::copy(node->label_data(), node->label_data() + node->label_len, &key[node->depth - node->label_len]);
+            }
+
+            std::vector<const Node*> stack{subtree_node};
+            bool first = true;
+            while (!stack.empty()) {
+                if (stack.size() > 1 && idle_count.load(std::memory_order_relaxed) > 0) {
+                    share(index, stack);
+                }
+
+                const Node* node = stack.back();
+                stack.pop_back();
+                if (!first) {
+                    key.resize(node->depth - node->label_len);
+                    key.append(node->label_data(), node->label_len);
+                }
+                first = false;
+
+                if (node->has_value()) {
+                    visitor(key_view_type(key.data(), key.size()), *node->value);
+                }
+                node->children.for_each([&stack](typename Node::unit_type, Node* child_node) {
+                    stack.push_back(child_node);
+                });
+            }
+        }
+
+        void share(const size_type index, std::vector<const Node*>& stack) {
+            // the bottom of the stack holds the shallowest, so the largest, pending subtrees
+            size_type count = stack.size() / 2;
+            for (size_type i = 0; i < count; ++i) {
+                push(index, stack[i]);
+            }
+            stack.erase(stack.begin(), stack.begin() + static_cast<std::ptrdiff_t>(count));
+        }
+    };
+
+    template <typename Tree, typename ForwardIt>
+    void radix_tree_parallel::assign(Tree& tree, ForwardIt first, ForwardIt last, std::size_t thread_count) {
+        using node_type = typename Tree::node_type;
+        using key_view_type = typename Tree::key_view_type;
+        using size_type = typename Tree::size_type;
+        using unit_type = typename Tree::unit_type;
+
+        thread_count = default_thread_count(thread_count);
+        constexpr bool shared_allocator = std::allocator_traits<typename Tree::allocator_type>::is_always_equal::value;
+        if (!shared_allocator || thread_count < 2 || first == last) {
+            tree.assign(first, last);
+            return;
+        }
+
+        // common prefix of the whole input is the one of its first and last keys, if the input is sorted
+        ForwardIt last_element = first;
+        for (ForwardIt it = first; it != last; ++it) {
+            last_element = it;
+        }
+        key_view_type first_key(first->first);
+        size_type common_len = tree.common_prefix_length(first_key, key_view_type(last_element->first));
+        key_view_type common_prefix = tree.split_key(first_key, 0, common_len);
+
+        // a key equal to the common prefix can only come first, then ranges of keys by their unit after it
+        ForwardIt prefix_entry = last;
+        ForwardIt it = first;
+        for (; it != last && tree.get_key_len(key_view_type(it->first)) == common_len; ++it) {
+            if (prefix_entry == last) {
+                prefix_entry = it;
+            }
+        }
+
+        struct key_range {
+            ForwardIt begin;
+            ForwardIt end;
+            size_type count;
+        };
+        std::vector<key_range> ranges;
+        size_type range_count = 0;
+        for (int previous_unit = -1; it != last; ++it) {
+            key_view_type key(it->first);
+            if (tree.get_key_len(key) <= common_len || Tree::key_unit(key, common_len) < previous_unit) {
+                tree.assign(first, last);       // not sorted
+                return;
+            }
+            if (Tree::key_unit(key, common_len) != previous_unit) {
+                if (!ranges.empty()) {
+                    ranges.back().end = it;
+                }
+                ranges.push_back(key_range{it, last, 0});
+                previous_unit = Tree::key_unit(key, common_len);
+            }
+            ranges.back().count++;
+            range_count++;
+        }
+        if (ranges.size() < 2) {
+            tree.assign(first, last);
+            return;
+        }
+
+        // consecutive ranges of about the same number of keys for every thread
+        std::vector<std::pair<size_type, size_type>> shares;
+        for (size_type begin = 0, end = 0, taken = 0; begin < ranges.size(); begin = end) {
+            size_type target = (range_count * (shares.size() + 1)) / thread_count;
+            for (end = begin; end < ranges.size() && (end == begin || taken < target); ++end) {
+                taken += ranges[end].count;
+            }
+            shares.emplace_back(begin, end);
+        }
+
+        std::vector<std::unique_ptr<Tree>> parts;
+        for (size_type i = 0; i < shares.size(); ++i) {
+            parts.push_back(std::make_unique<Tree>(tree.get_allocator()));
+        }
+        std::atomic<bool> unsorted{false};
+        run_on_threads(shares.size(), [&](const size_type index) {
+            Tree& part = *parts[index];
+            typename Tree::bulk_loader loader{part};
+            for (size_type range = shares[index].first; range < shares[index].second; ++range) {
+                for (ForwardIt entry = ranges[range].begin; entry != ranges[range].end; ++entry) {
+                    key_view_type key(entry->first);
+                    if (tree.split_key(key, 0, common_len) != common_prefix) {
+                        unsorted.store(true);
+                        return;
+                    }
+                    loader.add(tree.split_key(key, common_len), entry->second);
+                }
+            }
+            loader.finish();
+            shift_depths(part.root_node, common_len);
+        });
+        if (unsorted.load()) {
+            parts.clear();
+            tree.assign(first, last);
+            return;
+        }
+
+        // graft the children of every part root under the node of the common prefix
+        tree.clear();
+        node_type* top_node = tree.get_root_node();
+        if (common_len > 0) {
+            // growing the root table may throw, the new node is not linked yet
+            node_type* prefix_node = tree.create_node(common_prefix, top_node, common_len);
+            try {
+                tree.root_node->children.insert(Tree::key_unit(common_prefix, 0), prefix_node, tree.allocator);
+            } catch (...) {
+                tree.destroy_node(prefix_node);
+                throw;
+            }
+            top_node = prefix_node;
+        }
+        if (prefix_entry != last) {
+            try {
+                top_node->value = tree.create_value(prefix_entry->second);
+            } catch (...) {
+                tree.clear();
+                throw;
+            }
+            Tree::add_subtree_count(top_node, 1);
+            Tree::refresh_max_score(top_node);
+        }
+
+        size_type tree_size = prefix_entry != last ? 1 : 0;
+        std::vector<std::pair<unit_type, node_type*>> grafts;
+        grafts.reserve(ranges.size());
+        for (auto& part : parts) {
+            part->root_node->children.for_each([&grafts](const unit_type unit, node_type* child_node) {
+                grafts.emplace_back(unit, child_node);
+            });
+            part->root_node->children.clear(part->allocator);
+            tree_size += part->tree_size;
+            part->tree_size = 0;
+        }
+
+        size_type grafted = 0;
+        try {
+            for (; grafted < grafts.size(); ++grafted) {
+                grafts[grafted].second->parent_node = top_node;
+                top_node->children.insert(grafts[grafted].first, grafts[grafted].second, tree.allocator);
+                Tree::attach_subtree_count(top_node, grafts[grafted].second);
+                Tree::raise_max_score(top_node, grafts[grafted].second);
+            }
+        } catch (...) {
+            for (; grafted < grafts.size(); ++grafted) {
+                tree.destroy_subtree(grafts[grafted].second);
+            }
+            tree.clear();
+            throw;
+        }
+        tree.tree_size = tree_size;
+    }
+
+    template <typename Node, typename Visitor>
+    void radix_tree_parallel::visit(const Node* start_node, Visitor& visitor, std::size_t thread_count) {
+        if (start_node == nullptr) {
+            return;
+        }
+
+        thread_count = default_thread_count(thread_count);
+        visit_pool<Node, Visitor> pool{visitor, thread_count};
+        pool.push(0, start_node);
+        run_on_threads(thread_count, [&pool](const std::size_t index) {
+            pool.work(index);
+        });
+    }
+
+    template <typename Tree, typename ForwardIt>
+    inline void parallel_assign(Tree& tree, ForwardIt first, ForwardIt last, std::size_t thread_count) {
+        radix_tree_parallel::assign(tree, first, last, thread_count);
+    }
+
+    template <typename Tree, typename Visitor>
+    inline void parallel_for_each(const Tree& tree, Visitor visitor, std::size_t thread_count) {
+        radix_tree_parallel::for_each(tree, visitor, thread_count);
+    }
+
+    template <typename Tree, typename Visitor>
+    inline void parallel_for_each_with_prefix(const Tree& tree, typename Tree::key_view_type prefix, Visitor visitor, std::size_t thread_count) {
+        radix_tree_parallel::for_each_with_prefix(tree, prefix, visitor, thread_count);
+    }
+}
+
+#endif //PHAM_PHI_LONG_RADIX_TREE_PARALLEL_H
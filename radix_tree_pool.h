@@ -0,0 +1,246 @@
+//
+// Slab allocator for radix tree nodes.
+//
+
+#ifndef PHAM_PHI_LONG_RADIX_TREE_POOL_H
+#define PHAM_PHI_LONG_RADIX_TREE_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace phamphilong {
+    /**
+     * Memory pool handing out small blocks from large, cache line aligned chunks.
+     *
+     * Blocks are grouped into 16 byte size classes, a freed block goes to the free list of its class and
+     * is reused by the next allocation of the same class, so nodes freed by erase are recycled by insert.
+     * release() gives every chunk back at once, in O(chunks), without touching the blocks.
+     *
+     * The pool is not thread safe, just like radix_tree.
+     */
+    class radix_tree_pool {
+    public:
+        using size_type = std::size_t;
+
+        static constexpr size_type cache_line_size = 64;
+        static constexpr size_type size_class_granularity = 16;
+
+        explicit radix_tree_pool(const size_type chunk_size = 1 << 16)
+                : chunk_size{chunk_size < 4 * max_block_size ? 4 * max_block_size : chunk_size} {}
+        radix_tree_pool(const radix_tree_pool&) = delete;
+        radix_tree_pool& operator= (const radix_tree_pool&) = delete;
+        ~radix_tree_pool() {
+            release();
+        }
+
+        void* allocate(const size_type bytes, const size_type alignment);
+        void deallocate(void* block, const size_type bytes, const size_type alignment) noexcept;
+        void release() noexcept;
+
+        size_type chunk_count() const noexcept {
+            return chunks.size();
+        }
+
+        size_type allocated_bytes() const noexcept {
+            return chunks.size() * chunk_size + large_bytes;
+        }
+
+    private:
+        static constexpr size_type max_block_size = 4096;
+        static constexpr size_type size_class_count = max_block_size / size_class_granularity + 1;
+
+        struct free_block {
+            free_block* next;
+        };
+
+        struct large_block {
+            large_block* prev;
+            large_block* next;
+            size_type bytes;
+        };
+
+        static constexpr size_type large_header_size = (sizeof(large_block) + cache_line_size - 1) / cache_line_size * cache_line_size;
+
+        const size_type chunk_size;
+        std::vector<char*> chunks{};
+        char* cursor{nullptr};
+        char* chunk_end{nullptr};
+        free_block* free_lists[size_class_count]{};
+        large_block* large_blocks{nullptr};
+        size_type large_bytes{0};
+
+        static bool is_large(const size_type bytes, const size_type alignment) noexcept {
+            return bytes > max_block_size || alignment > cache_line_size;
+        }
+
+        static size_type size_class(const size_type bytes) noexcept {
+            return (bytes + size_class_granularity - 1) / size_class_granularity;
+        }
+
+        static size_type block_alignment(const size_type block_size) noexcept {
+            // blocks of 32 and 64 bytes are aligned to their size, so a node never straddles two cache lines
+            // more than it has to
+            size_type alignment = size_class_granularity;
+            while (alignment < cache_line_size && block_size % (alignment * 2) == 0) {
+                alignment *= 2;
+            }
+            return alignment;
+        }
+
+        void* allocate_large(const size_type bytes);
+        void deallocate_large(void* block) noexcept;
+    };
+
+    inline void* radix_tree_pool::allocate(const size_type bytes, const size_type alignment) {
+        if (is_large(bytes, alignment)) {
+            return allocate_large(bytes);
+        }
+
+        size_type block_class = size_class(bytes == 0 ? 1 : bytes);
+        if (free_lists[block_class] != nullptr) {
+            free_block* block = free_lists[block_class];
+            free_lists[block_class] = block->next;
+            return block;
+        }
+
+        size_type block_size = block_class * size_class_granularity;
+        size_type alignment_mask = block_alignment(block_size) - 1;
+        char* block = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(cursor) + alignment_mask) & ~alignment_mask);
+        if (cursor == nullptr || block + block_size > chunk_end) {
+            char* chunk = static_cast<char*>(::operator new(chunk_size, std::align_val_t{cache_line_size}));
+            chunks.push_back(chunk);
+            chunk_end = chunk + chunk_size;
+            block = chunk;
+        }
+
+        cursor = block + block_size;
+        return block;
+    }
+
+    inline void radix_tree_pool::deallocate(void* block, const size_type bytes, const size_type alignment) noexcept {
+        if (block == nullptr) {
+            return;
+        }
+
+        if (is_large(bytes, alignment)) {
+            deallocate_large(block);
+            return;
+        }
+
+        size_type block_class = size_class(bytes == 0 ? 1 : bytes);
+        auto freed_block = static_cast<free_block*>(block);
+        freed_block->next = free_lists[block_class];
+        free_lists[block_class] = freed_block;
+    }
+
+    inline void radix_tree_pool::release() noexcept {
+        for (char* chunk : chunks) {
+            ::operator delete(chunk, std::align_val_t{cache_line_size});
+        }
+        chunks.clear();
+        cursor = nullptr;
+        chunk_end = nullptr;
+        for (auto& free_list : free_lists) {
+            free_list = nullptr;
+        }
+
+        while (large_blocks != nullptr) {
+            large_block* next = large_blocks->next;
+            ::operator delete(large_blocks, std::align_val_t{cache_line_size});
+            large_blocks = next;
+        }
+        large_bytes = 0;
+    }
+
+    inline void* radix_tree_pool::allocate_large(const size_type bytes) {
+        // large blocks are linked together so that release() can free them too
+        auto block = static_cast<large_block*>(::operator new(large_header_size + bytes, std::align_val_t{cache_line_size}));
+        block->prev = nullptr;
+        block->next = large_blocks;
+        block->bytes = bytes;
+        if (large_blocks != nullptr) {
+            large_blocks->prev = block;
+        }
+        large_blocks = block;
+        large_bytes += bytes;
+        return reinterpret_cast<char*>(block) + large_header_size;
+    }
+
+    inline void radix_tree_pool::deallocate_large(void* block) noexcept {
+        auto header = reinterpret_cast<large_block*>(static_cast<char*>(block) - large_header_size);
+        if (header->prev != nullptr) {
+            header->prev->next = header->next;
+        } else {
+            large_blocks = header->next;
+        }
+        if (header->next != nullptr) {
+            header->next->prev = header->prev;
+        }
+        large_bytes -= header->bytes;
+        ::operator delete(header, std::align_val_t{cache_line_size});
+    }
+
+    /**
+     * STL allocator on top of a radix_tree_pool.
+     *
+     * A default constructed allocator creates its own pool, copies and rebinds share it. Plug it into a tree with
+     *      radix_tree<Key, T, split<Key>, radix_len<Key>, radix_tree_pool_allocator<std::pair<const Key, T>>>
+     *
+     * release() frees the whole pool, but only when no other allocator shares it; radix_tree::clear() uses it to
+     * drop all nodes at once.
+     */
+    template <typename T>
+    class radix_tree_pool_allocator {
+        template <typename U> friend class radix_tree_pool_allocator;
+
+    public:
+        using value_type = T;
+        using size_type = std::size_t;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        radix_tree_pool_allocator() : pool{std::make_shared<radix_tree_pool>()} {}
+        explicit radix_tree_pool_allocator(std::shared_ptr<radix_tree_pool> pool) : pool{std::move(pool)} {}
+        template <typename U>
+        radix_tree_pool_allocator(const radix_tree_pool_allocator<U>& other) noexcept : pool{other.pool} {}
+
+        T* allocate(const size_type n) {
+            return static_cast<T*>(pool->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* block, const size_type n) noexcept {
+            pool->deallocate(block, n * sizeof(T), alignof(T));
+        }
+
+        bool release() noexcept {
+            if (pool.use_count() != 1) {
+                return false;
+            }
+
+            pool->release();
+            return true;
+        }
+
+        const std::shared_ptr<radix_tree_pool>& get_pool() const noexcept {
+            return pool;
+        }
+
+        template <typename U>
+        bool operator== (const radix_tree_pool_allocator<U>& lhs) const noexcept {
+            return pool == lhs.pool;
+        }
+
+        template <typename U>
+        bool operator!= (const radix_tree_pool_allocator<U>& lhs) const noexcept {
+            return pool != lhs.pool;
+        }
+
+    private:
+        std::shared_ptr<radix_tree_pool> pool;
+    };
+}
+
+#endif //PHAM_PHI_LONG_RADIX_TREE_POOL_H
@@ -0,0 +1,154 @@
+//
+// Shape and memory report of a radix tree, and optional operation counters.
+//
+
+#ifndef PHAM_PHI_LONG_RADIX_TREE_STATS_H
+#define PHAM_PHI_LONG_RADIX_TREE_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace phamphilong {
+    /**
+     * What radix_tree::stats() finds walking the whole tree.
+     *
+     * Depths count edges from the root, the root is at depth 0. Split nodes are nodes other than the root without a
+     * value, insert creates them when a key branches off in the middle of an edge label; a tree of n keys never has
+     * more than n - 1 of them.
+     *
+     * Byte figures are what the tree asks its allocator for, allocator overhead is not included. A node keeps only
+     * its edge label, never a copy of the whole key: labels up to the inline capacity are part of node_bytes, longer
+     * ones are label_bytes.
+     */
+    struct radix_tree_stats {
+        using size_type = std::size_t;
+
+        size_type node_count{0};
+        size_type value_count{0};
+        size_type leaf_count{0};
+        size_type split_node_count{0};
+        size_type max_depth{0};
+        size_type total_label_length{0};        // in key units, over all nodes but the root
+        size_type heap_label_count{0};
+        std::vector<size_type> fanout_histogram{};  // fanout_histogram[n] : nodes with n children
+        std::vector<size_type> depth_histogram{};   // depth_histogram[d] : nodes at depth d
+
+        size_type node_bytes{0};
+        size_type children_bytes{0};
+        size_type value_bytes{0};
+        size_type label_bytes{0};
+
+        size_type total_bytes() const noexcept {
+            return node_bytes + children_bytes + value_bytes + label_bytes;
+        }
+
+        double average_label_length() const noexcept {
+            return node_count > 1 ? static_cast<double>(total_label_length) / static_cast<double>(node_count - 1) : 0.0;
+        }
+
+        double average_fanout() const noexcept {
+            // children per inner node
+            size_type inner_count = node_count - leaf_count;
+            return inner_count > 0 ? static_cast<double>(node_count - 1) / static_cast<double>(inner_count) : 0.0;
+        }
+    };
+
+    /**
+     * Counts of hot path events, see radix_tree::counters().
+     *
+     *      lookups       : descents of find_node, i.e. find() and erase()
+     *      lookup_steps  : nodes visited by those descents
+     *      insert_splits : edge labels split by insert
+     *      erase_merges  : nodes merged with their only child by erase
+     */
+    struct radix_tree_counters {
+        std::uint64_t lookups{0};
+        std::uint64_t lookup_steps{0};
+        std::uint64_t insert_splits{0};
+        std::uint64_t erase_merges{0};
+    };
+
+    /**
+     * Customization point turning on the hot path counters of the radix trees holding T values, off unless
+     * specialized:
+     *
+     *      template <>
+     *      struct radix_count_events<entry> : std::true_type {};
+     *
+     * A trait rather than a build flag, so that a tree type has the same layout in every translation unit.
+     */
+    template <typename T, typename Enable = void>
+    struct radix_count_events : std::false_type {};
+
+    /**
+     * Base of radix_tree, an empty class unless T turns counting on, so that disabled counters cost neither
+     * instructions nor tree size. Every count is an empty inline function then.
+     */
+    template <typename T, bool = radix_count_events<T>::value>
+    class radix_tree_event_counters {
+    public:
+        static constexpr bool enabled = false;
+
+        void count_lookup() const noexcept {}
+        void count_lookup_step() const noexcept {}
+        void count_insert_split() const noexcept {}
+        void count_erase_merge() const noexcept {}
+
+        radix_tree_counters snapshot() const noexcept {
+            return radix_tree_counters{};
+        }
+
+        void reset() const noexcept {}
+    };
+
+    // enabled, the tree counts events with relaxed atomics, so concurrent readers of one tree can still share it
+    template <typename T>
+    class radix_tree_event_counters<T, true> {
+    public:
+        static constexpr bool enabled = true;
+
+        radix_tree_event_counters() = default;
+        radix_tree_event_counters(const radix_tree_event_counters&) = delete;
+        radix_tree_event_counters& operator= (const radix_tree_event_counters&) = delete;
+
+        void count_lookup() const noexcept {
+            lookups.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void count_lookup_step() const noexcept {
+            lookup_steps.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void count_insert_split() const noexcept {
+            insert_splits.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void count_erase_merge() const noexcept {
+            erase_merges.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        radix_tree_counters snapshot() const noexcept {
+            return radix_tree_counters{lookups.load(std::memory_order_relaxed), lookup_steps.load(std::memory_order_relaxed),
+                                       insert_splits.load(std::memory_order_relaxed), erase_merges.load(std::memory_order_relaxed)};
+        }
+
+        void reset() const noexcept {
+            lookups.store(0, std::memory_order_relaxed);
+            lookup_steps.store(0, std::memory_order_relaxed);
+            insert_splits.store(0, std::memory_order_relaxed);
+            erase_merges.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        // counted from const member functions, e.g. find()
+        mutable std::atomic<std::uint64_t> lookups{0};
+        mutable std::atomic<std::uint64_t> lookup_steps{0};
+        mutable std::atomic<std::uint64_t> insert_splits{0};
+        mutable std::atomic<std::uint64_t> erase_merges{0};
+    };
+}
+
+#endif //PHAM_PHI_LONG_RADIX_TREE_STATS_H
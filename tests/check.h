@@ -0,0 +1,35 @@
+//
+// Minimal checks shared by the tests: a failed check is reported and counted, the test keeps going.
+//
+
+#ifndef PHAM_PHI_LONG_TESTS_CHECK_H
+#define PHAM_PHI_LONG_TESTS_CHECK_H
+
+#include <atomic>
+#include <iostream>
+
+namespace phamphilong_test {
+    inline std::atomic<int>& failures() {
+        static std::atomic<int> count{0};
+        return count;
+    }
+
+    inline void check(const bool passed, const char* condition, const char* file, const int line) {
+        // counted atomically, checks may run on several threads
+        if (!passed && failures()++ < 20) {
+            std::cerr << file << ":" << line << ": check failed: " << condition << std::endl;
+        }
+    }
+
+    inline int report(const char* test_name) {
+        // exit code of the test
+        int failed = failures().load();
+        std::cout << test_name << ": " << (failed == 0 ? "passed" : "FAILED") << " (" << failed << " failed checks)" << std::endl;
+        return failed == 0 ? 0 : 1;
+    }
+}
+
+// not assert: the tests are built in Release, with NDEBUG
+#define RADIX_TREE_CHECK(condition) ::phamphilong_test::check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+#endif //PHAM_PHI_LONG_TESTS_CHECK_H
@@ -0,0 +1,141 @@
+// concurrent_radix_tree under concurrent insert, erase and find, checked against what each thread did
+#include "check.h"
+#include "concurrent_radix_tree.h"
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    const std::size_t thread_count = 4;
+    const std::size_t keys_per_thread = 3000;
+    const std::size_t shared_key_count = 2000;
+    const std::size_t stable_key_count = 1000;
+
+    std::string owned_key(const std::size_t thread, const std::size_t i) {
+        // keys of different threads interleave, so that they split and merge the same nodes
+        return "key/" + std::to_string(i * thread_count + thread);
+    }
+
+    void check_writers_and_readers() {
+        concurrent_radix_tree<std::string, std::size_t> tree;
+        for (std::size_t i = 0; i < stable_key_count; ++i) {
+            tree.insert({"key/stable/" + std::to_string(i), i});
+        }
+
+        std::atomic<bool> writers_done{false};
+        std::atomic<std::size_t> shared_inserted{0};
+        std::atomic<std::size_t> shared_erased{0};
+        std::atomic<std::size_t> inserts_done{0};
+        std::vector<std::thread> threads;
+        for (std::size_t thread = 0; thread < thread_count; ++thread) {
+            threads.emplace_back([&, thread] {
+                // every owned key is inserted, odd ones erased again
+                for (std::size_t i = 0; i < keys_per_thread; ++i) {
+                    RADIX_TREE_CHECK(tree.insert({owned_key(thread, i), i}));
+                    RADIX_TREE_CHECK(!tree.insert({owned_key(thread, i), i + 1}));
+                }
+                for (std::size_t i = 1; i < keys_per_thread; i += 2) {
+                    RADIX_TREE_CHECK(tree.erase(owned_key(thread, i)) == 1);
+                    RADIX_TREE_CHECK(!tree.find(owned_key(thread, i)).has_value());
+                }
+
+                // all threads race for the same keys, exactly one insert and one erase of each wins
+                for (std::size_t i = 0; i < shared_key_count; ++i) {
+                    shared_inserted += tree.insert({"key/shared/" + std::to_string(i), i}) ? 1 : 0;
+                }
+                // nobody erases before everybody inserted, or a key could be inserted twice
+                ++inserts_done;
+                while (inserts_done.load() < thread_count) {
+                    std::this_thread::yield();
+                }
+                for (std::size_t i = 0; i < shared_key_count; ++i) {
+                    shared_erased += tree.erase("key/shared/" + std::to_string(i));
+                }
+            });
+        }
+
+        for (std::size_t reader = 0; reader < 2; ++reader) {
+            threads.emplace_back([&] {
+                // keys nobody writes are always found, with their value, while the tree changes around them
+                while (!writers_done.load()) {
+                    for (std::size_t i = 0; i < stable_key_count; i += 7) {
+                        auto value = tree.find("key/stable/" + std::to_string(i));
+                        RADIX_TREE_CHECK(value.has_value() && *value == i);
+                    }
+                    RADIX_TREE_CHECK(!tree.find("key/missing").has_value());
+                }
+            });
+        }
+
+        for (std::size_t thread = 0; thread < thread_count; ++thread) {
+            threads[thread].join();
+        }
+        writers_done = true;
+        for (std::size_t thread = thread_count; thread < threads.size(); ++thread) {
+            threads[thread].join();
+        }
+
+        RADIX_TREE_CHECK(shared_inserted.load() == shared_key_count);
+        RADIX_TREE_CHECK(shared_erased.load() == shared_key_count);
+        for (std::size_t thread = 0; thread < thread_count; ++thread) {
+            for (std::size_t i = 0; i < keys_per_thread; ++i) {
+                auto value = tree.find(owned_key(thread, i));
+                RADIX_TREE_CHECK(i % 2 == 0 ? value.has_value() && *value == i : !value.has_value());
+            }
+        }
+        RADIX_TREE_CHECK(tree.size() == stable_key_count + thread_count * ((keys_per_thread + 1) / 2));
+    }
+
+    void check_many_live_threads() {
+        // more threads alive than epoch slots, e.g. a large pool: slots are only held inside an operation
+        concurrent_radix_tree<std::string, std::size_t> tree;
+        const std::size_t live_threads = 300;
+        std::atomic<std::size_t> finished{0};
+        std::atomic<bool> release{false};
+        std::vector<std::thread> threads;
+        for (std::size_t thread = 0; thread < live_threads; ++thread) {
+            threads.emplace_back([&, thread] {
+                for (std::size_t i = 0; i < 10; ++i) {
+                    tree.insert({"pool/" + std::to_string(thread) + "/" + std::to_string(i), i});
+                }
+                ++finished;
+                while (!release.load()) {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        while (finished.load() < live_threads) {
+            std::this_thread::yield();
+        }
+        release = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        RADIX_TREE_CHECK(tree.size() == live_threads * 10);
+    }
+
+    void check_deep_tree() {
+        // a chain of nodes as deep as the keys are long, the destructor must not recurse
+        concurrent_radix_tree<std::string, std::size_t> tree;
+        std::string key;
+        for (std::size_t i = 0; i < 60000; ++i) {
+            key += 'a';
+            if (i % 3 == 0) {
+                tree.insert({key, i});
+            }
+        }
+        RADIX_TREE_CHECK(tree.size() == 20000);
+        RADIX_TREE_CHECK(tree.find(std::string(30001, 'a')) == std::size_t{30000});
+    }
+}
+
+int main() {
+    check_writers_and_readers();
+    check_many_live_threads();
+    check_deep_tree();
+    return phamphilong_test::report("concurrent_test");
+}
@@ -0,0 +1,227 @@
+// frozen_radix_tree: images written from a radix_tree read back the same entries, damaged images are rejected
+#include "check.h"
+#include "frozen_radix_tree.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    using tree_type = radix_tree<std::string, long>;
+    using frozen_type = frozen_radix_tree<std::string, long>;
+    using model_type = std::map<std::string, long>;
+
+    std::string random_key(std::mt19937_64& rng) {
+        std::string key;
+        for (std::size_t len = rng() % 10; len > 0; --len) {
+            key += "abc\xff"[rng() % 4];
+        }
+        return key;
+    }
+
+    std::vector<std::uint64_t> write_image(const tree_type& tree, std::size_t& image_size) {
+        // images are read in place, so they go to 8 byte aligned memory
+        std::ostringstream out;
+        frozen_type::write(tree, out);
+        std::string bytes = out.str();
+        std::vector<std::uint64_t> image((bytes.size() + 7) / 8);
+        std::memcpy(image.data(), bytes.data(), bytes.size());
+        image_size = bytes.size();
+        return image;
+    }
+
+    bool same_entries(const frozen_type& frozen, const model_type& model) {
+        auto it = frozen.begin();
+        for (auto& entry : model) {
+            if (it == frozen.end() || it.key() != entry.first || it.value() != entry.second) {
+                return false;
+            }
+            auto found = frozen.find(entry.first);
+            if (found == frozen.end() || found->second != entry.second) {
+                return false;
+            }
+            ++it;
+        }
+        return it == frozen.end() && frozen.size() == model.size();
+    }
+
+    void check_prefix(const frozen_type& frozen, const model_type& model, const std::string& prefix) {
+        const frozen_type::size_type limit = prefix.size();
+        std::size_t count = 0;
+        auto it = frozen.find_with_prefix(prefix).begin();
+        auto limited = frozen.find_with_prefix(prefix, limit).begin();
+        for (auto entry = model.lower_bound(prefix); entry != model.end() && entry->first.compare(0, prefix.size(), prefix) == 0; ++entry, ++it, ++count) {
+            RADIX_TREE_CHECK(it != frozen.end() && it.key() == entry->first && it.value() == entry->second);
+            if (count < limit) {
+                RADIX_TREE_CHECK(limited != frozen.end() && limited.key() == entry->first);
+                ++limited;
+            }
+        }
+        RADIX_TREE_CHECK(it == frozen.find_with_prefix(prefix).end());
+        RADIX_TREE_CHECK(limited == frozen.find_with_prefix(prefix, limit).end());
+    }
+
+    void check_round_trip() {
+        std::mt19937_64 rng{13};
+        tree_type tree;
+        model_type model;
+        for (long i = 0; i < 20000; ++i) {
+            std::string key = random_key(rng);
+            tree.insert({key, i});
+            model.insert({key, i});
+        }
+
+        std::size_t image_size;
+        auto image = write_image(tree, image_size);
+        frozen_type frozen{image.data(), image_size};
+        RADIX_TREE_CHECK(same_entries(frozen, model));
+        for (int i = 0; i < 500; ++i) {
+            std::string key = random_key(rng);
+            auto found = frozen.find(key);
+            RADIX_TREE_CHECK(model.count(key) == 0 ? found == frozen.end() : found != frozen.end() && found->second == model.at(key));
+            check_prefix(frozen, model, key.substr(0, key.size() / 2));
+        }
+        check_prefix(frozen, model, "");
+
+#if defined(__unix__) || defined(__APPLE__)
+        // the same image through a file and a memory map
+        const std::string path = "frozen_test.image";
+        {
+            std::ofstream out{path, std::ios::binary};
+            frozen_type::write(tree, out);
+        }
+        {
+            radix_tree_mapped_file file{path};
+            frozen_type mapped{file.data(), file.size()};
+            RADIX_TREE_CHECK(file.size() == image_size);
+            RADIX_TREE_CHECK(same_entries(mapped, model));
+        }
+        std::remove(path.c_str());
+#endif
+    }
+
+    void check_small_trees() {
+        // no key, only the empty key, a single key
+        for (const char* key : {static_cast<const char*>(nullptr), "", "abc"}) {
+            tree_type tree;
+            model_type model;
+            if (key != nullptr) {
+                tree.insert({key, 7});
+                model.insert({key, 7});
+            }
+            std::size_t image_size;
+            auto image = write_image(tree, image_size);
+            frozen_type frozen{image.data(), image_size};
+            RADIX_TREE_CHECK(same_entries(frozen, model));
+            RADIX_TREE_CHECK(frozen.empty() == model.empty());
+            RADIX_TREE_CHECK(frozen.find("ab") == frozen.end());
+            check_prefix(frozen, model, "");
+            check_prefix(frozen, model, "a");
+        }
+    }
+
+    template <typename Frozen>
+    bool rejected(const void* image, const std::size_t image_size) {
+        try {
+            Frozen frozen{image, image_size};
+            return false;
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+    }
+
+    void check_rejected_images() {
+        tree_type tree;
+        for (long i = 0; i < 1000; ++i) {
+            tree.insert({"key/" + std::to_string(i), i});
+        }
+        std::size_t image_size;
+        auto image = write_image(tree, image_size);
+        RADIX_TREE_CHECK(!rejected<frozen_type>(image.data(), image_size));
+
+        // another value type, a short read, a misaligned start
+        RADIX_TREE_CHECK((rejected<frozen_radix_tree<std::string, int>>(image.data(), image_size)));
+        RADIX_TREE_CHECK(rejected<frozen_type>(image.data(), image_size - 8));
+        RADIX_TREE_CHECK(rejected<frozen_type>(image.data(), 16));
+        RADIX_TREE_CHECK(rejected<frozen_type>(reinterpret_cast<const char*>(image.data()) + 4, image_size - 8));
+
+        // a root outside the image
+        using header_type = frozen_radix_tree_format<char, long>::header;
+        auto corrupt = image;
+        std::uint32_t root = static_cast<std::uint32_t>(image.size() + 1);
+        std::memcpy(reinterpret_cast<char*>(corrupt.data()) + offsetof(header_type, root), &root, sizeof(root));
+        RADIX_TREE_CHECK(rejected<frozen_type>(corrupt.data(), image_size));
+    }
+
+    void check_damaged_images() {
+        // random damage past the header either throws or leaves lookups within the image, never more
+        std::mt19937_64 rng{17};
+        tree_type tree;
+        for (long i = 0; i < 2000; ++i) {
+            tree.insert({random_key(rng), i});
+        }
+        std::size_t image_size;
+        const auto image = write_image(tree, image_size);
+        const std::size_t header_size = sizeof(frozen_radix_tree_format<char, long>::header);
+        for (int round = 0; round < 500; ++round) {
+            auto damaged = image;
+            char* bytes = reinterpret_cast<char*>(damaged.data());
+            for (std::size_t flips = 1 + rng() % 8; flips > 0; --flips) {
+                bytes[header_size + rng() % (image_size - header_size)] = static_cast<char>(rng());
+            }
+            try {
+                frozen_type frozen{damaged.data(), image_size};
+                std::size_t count = 0;
+                for (auto it = frozen.begin(); it != frozen.end() && count <= image_size; ++it) {
+                    ++count;
+                }
+                for (int i = 0; i < 20; ++i) {
+                    std::string key = random_key(rng);
+                    frozen.find(key);
+                    count = 0;
+                    auto range = frozen.find_with_prefix(key.substr(0, 2));
+                    for (auto it = range.begin(); it != range.end() && count <= image_size; ++it) {
+                        ++count;
+                    }
+                }
+            } catch (const std::invalid_argument&) {
+            }
+        }
+    }
+
+    void check_deep_tree() {
+        // writing a chain of nodes as deep as the keys are long must not recurse
+        tree_type tree;
+        model_type model;
+        std::string key;
+        for (long i = 0; i < 100000; ++i) {
+            key += 'a';
+            if (i % 20 == 0) {
+                tree.insert({key, i});
+                model.insert({key, i});
+            }
+        }
+        std::size_t image_size;
+        auto image = write_image(tree, image_size);
+        frozen_type frozen{image.data(), image_size};
+        RADIX_TREE_CHECK(same_entries(frozen, model));
+    }
+}
+
+int main() {
+    check_round_trip();
+    check_small_trees();
+    check_rejected_images();
+    check_damaged_images();
+    check_deep_tree();
+    return phamphilong_test::report("frozen_test");
+}
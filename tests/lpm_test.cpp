@@ -0,0 +1,113 @@
+// lpm_radix_tree against a brute force search over a std::map of (prefix, length) entries
+#include "check.h"
+#include "lpm_radix_tree.h"
+#include "radix_tree_integer_key.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+using namespace phamphilong;
+
+namespace {
+    template <typename Key>
+    using model_type = std::map<std::pair<Key, std::size_t>, int>;
+
+    template <typename Tree, typename Key>
+    bool same_match(const Tree& tree, const model_type<Key>& model, const Key& address) {
+        // the longest stored prefix of address, trying every length from the longest down
+        using bits = radix_bits<Key>;
+        auto match = tree.longest_prefix_match(address);
+        for (std::size_t len = bits::width + 1; len-- > 0; ) {
+            auto entry = model.find({bits::mask(address, len), len});
+            if (entry != model.end()) {
+                return match.value != nullptr && *match.value == entry->second && match.prefix_len == len;
+            }
+        }
+        return match.value == nullptr;
+    }
+
+    template <typename Key, typename RandomKey>
+    void check_against_brute_force(RandomKey random_key) {
+        using bits = radix_bits<Key>;
+        std::mt19937_64 rng{19};
+        lpm_radix_tree<Key, int> tree;
+        model_type<Key> model;
+        for (int step = 0; step < 20000; ++step) {
+            // unmasked prefixes, the bits past the length are ignored
+            Key prefix = random_key(rng);
+            std::size_t len = rng() % (bits::width + 1);
+            std::pair<Key, std::size_t> entry{bits::mask(prefix, len), len};
+            if (rng() % 3 != 0) {
+                auto inserted = tree.insert(prefix, len, step);
+                RADIX_TREE_CHECK(inserted.second == model.insert({entry, step}).second);
+                RADIX_TREE_CHECK(inserted.first != nullptr && *inserted.first == model.at(entry));
+            } else {
+                RADIX_TREE_CHECK(tree.erase(prefix, len) == model.erase(entry));
+            }
+            RADIX_TREE_CHECK(tree.size() == model.size());
+
+            int* found = tree.find(prefix, len);
+            auto expected = model.find(entry);
+            RADIX_TREE_CHECK(expected == model.end() ? found == nullptr : found != nullptr && *found == expected->second);
+            RADIX_TREE_CHECK(same_match(tree, model, random_key(rng)));
+        }
+        for (auto& entry : model) {
+            RADIX_TREE_CHECK(same_match(tree, model, entry.first.first));
+        }
+    }
+
+    void check_prefix_lengths() {
+        // lengths past the key width are rejected before anything changes
+        lpm_radix_tree<std::uint32_t, int> tree;
+        tree.insert(0x0A000000, 8, 1);
+        bool thrown = false;
+        try {
+            tree.insert(0x0A000000, 33, 2);
+        } catch (const std::out_of_range&) {
+            thrown = true;
+        }
+        RADIX_TREE_CHECK(thrown);
+        thrown = false;
+        try {
+            tree.erase(0x0A000000, 64);
+        } catch (const std::out_of_range&) {
+            thrown = true;
+        }
+        RADIX_TREE_CHECK(thrown);
+        RADIX_TREE_CHECK(tree.find(0x0A000000, 33) == nullptr);
+        RADIX_TREE_CHECK(tree.size() == 1 && *tree.find(0x0A000000, 8) == 1);
+        RADIX_TREE_CHECK(tree.insert(0x0A000001, 32, 3).second && tree.erase(0x0A000001, 32) == 1);
+    }
+
+    void check_integer_view() {
+        // substr clamps like std::string_view::substr, without throwing
+        radix_integer_view<std::uint32_t> view{0xC0A80001};
+        RADIX_TREE_CHECK(view.substr(1, 2).size() == 2 && view.substr(1, 2)[0] == static_cast<char>(0xA8));
+        RADIX_TREE_CHECK(view.substr(2).size() == 2);
+        RADIX_TREE_CHECK(view.substr(4).size() == 0);
+        RADIX_TREE_CHECK(view.substr(9).size() == 0);
+        RADIX_TREE_CHECK(view.substr(9, 3).size() == 0);
+    }
+}
+
+int main() {
+    check_against_brute_force<std::uint32_t>([](std::mt19937_64& rng) {
+        // few distinct high bytes, so that prefixes nest
+        return static_cast<std::uint32_t>(((rng() % 4) << 30) | (rng() & 0x3FFFFFFF));
+    });
+    check_against_brute_force<std::array<std::uint8_t, 16>>([](std::mt19937_64& rng) {
+        std::array<std::uint8_t, 16> address{};
+        address[0] = 0x20;
+        for (std::size_t i = 1; i < address.size(); ++i) {
+            address[i] = static_cast<std::uint8_t>(i < 3 ? rng() % 2 : rng());
+        }
+        return address;
+    });
+    check_prefix_lengths();
+    check_integer_view();
+    return phamphilong_test::report("lpm_test");
+}
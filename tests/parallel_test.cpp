@@ -0,0 +1,188 @@
+// parallel_assign and parallel_for_each against std::map and the sequential tree
+#include "check.h"
+#include "radix_tree_parallel.h"
+#include "radix_tree_pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    struct entry {
+        std::uint32_t score;
+        int id;
+
+        bool operator== (const entry& other) const {
+            return score == other.score && id == other.id;
+        }
+        bool operator!= (const entry& other) const {
+            return !(*this == other);
+        }
+    };
+}
+
+namespace phamphilong {
+    template <>
+    struct radix_score<entry> {
+        using score_type = std::uint32_t;
+
+        static score_type get(const entry& value) {
+            return value.score;
+        }
+    };
+
+    template <>
+    struct radix_subtree_count<entry> : std::true_type {};
+}
+
+using namespace phamphilong;
+
+namespace {
+    using tree_type = radix_tree<std::string, entry>;
+    using pool_tree_type = radix_tree<std::string, entry, split<std::string>, radix_len<std::string>,
+                                      radix_tree_pool_allocator<std::pair<const std::string, entry>>>;
+    using model_type = std::map<std::string, entry>;
+
+    model_type random_model(std::mt19937_64& rng, const std::string& common_prefix, const std::size_t size) {
+        // keys diverge right after the common prefix on many units, and share prefixes further down
+        model_type model;
+        for (int i = 0; model.size() < size; ++i) {
+            std::string key = common_prefix;
+            for (std::size_t len = 1 + rng() % 8; len > 0; --len) {
+                key += rng() % 3 == 0 ? static_cast<char>(rng()) : "ab"[rng() % 2];
+            }
+            model.insert({key, entry{static_cast<std::uint32_t>(rng() % 100), i}});
+        }
+        return model;
+    }
+
+    template <typename Tree>
+    bool same_entries(const Tree& tree, const model_type& model) {
+        auto it = tree.begin();
+        for (auto& entry : model) {
+            if (it == tree.end() || it.key() != entry.first || it->second != entry.second) {
+                return false;
+            }
+            ++it;
+        }
+        return it == tree.end() && tree.size() == model.size();
+    }
+
+    template <typename Tree>
+    bool same_shape(const Tree& tree, const tree_type& sequential) {
+        // grafted subtrees carry their counts and scores up, so rank, select and top_k see the whole tree
+        radix_tree_stats stats = tree.stats();
+        radix_tree_stats expected = sequential.stats();
+        if (stats.node_count != expected.node_count || stats.fanout_histogram != expected.fanout_histogram ||
+            stats.depth_histogram != expected.depth_histogram) {
+            return false;
+        }
+        for (auto it = sequential.begin(); it != sequential.end(); ++it) {
+            std::string key = it.key();
+            if (tree.rank(key) != sequential.rank(key) || tree.count_with_prefix(key) != sequential.count_with_prefix(key)) {
+                return false;
+            }
+        }
+        for (const char* prefix : {"", "c", "common/", "common/a", "common/b"}) {
+            auto best = tree.top_k_with_prefix(prefix, 5);
+            auto expected_best = sequential.top_k_with_prefix(prefix, 5);
+            if (best.size() != expected_best.size()) {
+                return false;
+            }
+            for (std::size_t i = 0; i < best.size(); ++i) {
+                if (best[i]->second.score != expected_best[i]->second.score) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template <typename Tree>
+    void check_assign(const model_type& model, const std::size_t thread_count) {
+        tree_type sequential;
+        sequential.assign(model.begin(), model.end());
+
+        // sorted input is cut into ranges and built on threads, shuffled input falls back to inserts
+        Tree tree;
+        tree.insert({"stale", entry{0, 0}});
+        parallel_assign(tree, model.begin(), model.end(), thread_count);
+        RADIX_TREE_CHECK(same_entries(tree, model));
+        RADIX_TREE_CHECK(same_shape(tree, sequential));
+
+        std::vector<std::pair<std::string, entry>> shuffled(model.begin(), model.end());
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64{shuffled.size()});
+        Tree unsorted_tree;
+        parallel_assign(unsorted_tree, shuffled.begin(), shuffled.end(), thread_count);
+        RADIX_TREE_CHECK(same_entries(unsorted_tree, model));
+        RADIX_TREE_CHECK(same_shape(unsorted_tree, sequential));
+    }
+
+    void check_parallel_assign() {
+        std::mt19937_64 rng{41};
+        for (std::size_t thread_count : {1, 2, 4, 0}) {
+            // no common prefix, a long one kept in a heap label, the common prefix a key itself, a single key
+            for (const std::string& prefix : {std::string(), std::string("common/"), "common/" + std::string(40, 'p')}) {
+                model_type model = random_model(rng, prefix, 5000);
+                check_assign<tree_type>(model, thread_count);
+                model.insert({prefix, entry{1000, -1}});
+                check_assign<tree_type>(model, thread_count);
+                check_assign<pool_tree_type>(model, thread_count);
+            }
+            check_assign<tree_type>(model_type{{"single", entry{1, 1}}}, thread_count);
+            check_assign<tree_type>(model_type{}, thread_count);
+        }
+    }
+
+    void check_parallel_for_each() {
+        // every entry exactly once, with its key, whatever thread visits it
+        std::mt19937_64 rng{43};
+        model_type model = random_model(rng, "", 20000);
+        model.insert({"", entry{1, -1}});
+        tree_type tree;
+        tree.assign(model.begin(), model.end());
+
+        for (std::size_t thread_count : {1, 3, 8, 0}) {
+            for (const char* prefix : {"", "a", "ab", "b", "\xff", "missing"}) {
+                std::mutex visited_mutex;
+                model_type visited;
+                std::size_t duplicates = 0;
+                auto visitor = [&](typename tree_type::key_view_type key, const entry& value) {
+                    std::lock_guard<std::mutex> lock{visited_mutex};
+                    duplicates += visited.insert({std::string(key), value}).second ? 0 : 1;
+                };
+                if (*prefix == '\0') {
+                    parallel_for_each(tree, visitor, thread_count);
+                } else {
+                    parallel_for_each_with_prefix(tree, prefix, visitor, thread_count);
+                }
+
+                model_type expected;
+                for (auto entry = model.lower_bound(prefix); entry != model.end() && entry->first.compare(0, std::char_traits<char>::length(prefix), prefix) == 0; ++entry) {
+                    expected.insert(*entry);
+                }
+                RADIX_TREE_CHECK(duplicates == 0);
+                RADIX_TREE_CHECK(visited == expected);
+            }
+        }
+
+        // an empty tree visits nothing
+        tree_type empty;
+        std::size_t visits = 0;
+        parallel_for_each(empty, [&visits](typename tree_type::key_view_type, const entry&) {
+            ++visits;
+        }, 4);
+        RADIX_TREE_CHECK(visits == 0);
+    }
+}
+
+int main() {
+    check_parallel_assign();
+    check_parallel_for_each();
+    return phamphilong_test::report("parallel_test");
+}
@@ -0,0 +1,193 @@
+// persistent_radix_tree against std::map: every snapshot and copy keeps its version while the tree moves on
+#include "check.h"
+#include "persistent_radix_tree.h"
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace phamphilong;
+
+namespace {
+    using tree_type = persistent_radix_tree<std::string, int>;
+    using model_type = std::map<std::string, int>;
+
+    std::string random_key(std::mt19937_64& rng) {
+        // few units, so that keys share prefixes, split and merge nodes
+        std::string key;
+        for (std::size_t len = rng() % 7; len > 0; --len) {
+            key += "abc"[rng() % 3];
+        }
+        return key;
+    }
+
+    template <typename Version>
+    bool same_entries(const Version& version, const model_type& model) {
+        // iteration in key order, find of every key and size
+        auto it = version.begin();
+        for (auto& entry : model) {
+            if (it == version.end() || it.key() != entry.first || it.value() != entry.second) {
+                return false;
+            }
+            const int* found = version.find(entry.first);
+            if (found == nullptr || *found != entry.second) {
+                return false;
+            }
+            ++it;
+        }
+        return it == version.end() && version.size() == model.size();
+    }
+
+    bool same_prefix_range(const tree_type::snapshot_type& snapshot, const model_type& model, const std::string& prefix) {
+        auto range = snapshot.find_with_prefix(prefix);
+        auto it = range.begin();
+        for (auto entry = model.lower_bound(prefix); entry != model.end() && entry->first.compare(0, prefix.size(), prefix) == 0; ++entry) {
+            if (it == range.end() || it.key() != entry->first || it.value() != entry->second) {
+                return false;
+            }
+            ++it;
+        }
+        return it == range.end();
+    }
+
+    void check_snapshot_isolation() {
+        std::mt19937_64 rng{7};
+        tree_type tree;
+        model_type model;
+        std::vector<std::pair<tree_type::snapshot_type, model_type>> versions;
+        for (std::size_t step = 0; step < 20000; ++step) {
+            std::string key = random_key(rng);
+            int value = static_cast<int>(step);
+            switch (rng() % 4) {
+                case 0:
+                case 1:
+                    RADIX_TREE_CHECK(tree.insert({key, value}) == model.insert({key, value}).second);
+                    break;
+                case 2:
+                    RADIX_TREE_CHECK(tree.insert_or_assign(key, value) == model.insert_or_assign(key, value).second);
+                    break;
+                default:
+                    RADIX_TREE_CHECK(tree.erase(key) == model.erase(key));
+                    break;
+            }
+            const int* found = tree.find(key);
+            auto entry = model.find(key);
+            RADIX_TREE_CHECK(entry == model.end() ? found == nullptr : found != nullptr && *found == entry->second);
+
+            if (step % 250 == 0) {
+                versions.emplace_back(tree.snapshot(), model);
+            }
+            if (step % 1000 == 999) {
+                // every version taken so far still reads as it was, the latest changes left them alone
+                for (auto& version : versions) {
+                    RADIX_TREE_CHECK(same_entries(version.first, version.second));
+                }
+                if (versions.size() > 8) {
+                    // dropping old versions frees what only they referenced
+                    versions.erase(versions.begin(), versions.begin() + 4);
+                }
+            }
+        }
+
+        RADIX_TREE_CHECK(same_entries(tree.snapshot(), model));
+        for (auto& version : versions) {
+            RADIX_TREE_CHECK(same_entries(version.first, version.second));
+            for (const char* prefix : {"", "a", "ab", "cab", "bbbbbb"}) {
+                RADIX_TREE_CHECK(same_prefix_range(version.first, version.second, prefix));
+            }
+        }
+    }
+
+    void check_copies() {
+        // a copy is another version, changes to either side stay on that side
+        tree_type tree;
+        model_type model;
+        for (int i = 0; i < 200; ++i) {
+            tree.insert({"key/" + std::to_string(i), i});
+            model.insert({"key/" + std::to_string(i), i});
+        }
+
+        tree_type copy = tree;
+        model_type copy_model = model;
+        for (int i = 0; i < 200; i += 3) {
+            tree.erase("key/" + std::to_string(i));
+            model.erase("key/" + std::to_string(i));
+            copy.insert_or_assign("key/" + std::to_string(i), -i);
+            copy_model["key/" + std::to_string(i)] = -i;
+        }
+        copy.insert({"key/", 1000});
+        copy_model.insert({"key/", 1000});
+
+        RADIX_TREE_CHECK(same_entries(tree.snapshot(), model));
+        RADIX_TREE_CHECK(same_entries(copy.snapshot(), copy_model));
+    }
+
+    void check_concurrent_readers() {
+        // readers check their snapshots while the writer keeps changing the tree and taking new ones
+        tree_type tree;
+        model_type model;
+        for (int i = 0; i < 2000; ++i) {
+            tree.insert({std::to_string(i * 7919 % 2000), i});
+            model.insert({std::to_string(i * 7919 % 2000), i});
+        }
+
+        std::atomic<bool> writer_done{false};
+        std::vector<std::thread> readers;
+        for (std::size_t reader = 0; reader < 3; ++reader) {
+            auto snapshot = tree.snapshot();
+            readers.emplace_back([snapshot, model, &writer_done] {
+                do {
+                    RADIX_TREE_CHECK(same_entries(snapshot, model));
+                } while (!writer_done.load());
+            });
+        }
+
+        std::mt19937_64 rng{11};
+        std::vector<tree_type::snapshot_type> dropped;
+        for (int step = 0; step < 20000; ++step) {
+            std::string key = std::to_string(rng() % 3000);
+            if (rng() % 2 == 0) {
+                tree.insert_or_assign(key, step);
+            } else {
+                tree.erase(key);
+            }
+            if (step % 100 == 0) {
+                dropped.push_back(tree.snapshot());
+            }
+        }
+        writer_done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        RADIX_TREE_CHECK(dropped.size() == 200);
+    }
+
+    void check_deep_tree() {
+        // releasing a chain as deep as the keys are long must not recurse
+        tree_type tree;
+        std::string key;
+        for (int i = 0; i < 20000; ++i) {
+            key += 'a';
+            if (i % 2 == 0) {
+                tree.insert({key, i});
+            }
+        }
+        auto snapshot = tree.snapshot();
+        tree.erase(std::string(10001, 'a'));
+        tree.clear();
+        RADIX_TREE_CHECK(snapshot.size() == 10000);
+        RADIX_TREE_CHECK(snapshot.find(std::string(10001, 'a')) != nullptr);
+    }
+}
+
+int main() {
+    check_snapshot_isolation();
+    check_copies();
+    check_concurrent_readers();
+    check_deep_tree();
+    return phamphilong_test::report("persistent_test");
+}
@@ -0,0 +1,575 @@
+// radix_tree against std::map: random inserts and erases, then every query compared with the same query on the map
+#include "check.h"
+#include "radix_tree.h"
+#include "radix_tree_pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    struct entry {
+        std::uint32_t score;
+        int id;
+
+        bool operator== (const entry& other) const {
+            return score == other.score && id == other.id;
+        }
+        bool operator!= (const entry& other) const {
+            return !(*this == other);
+        }
+    };
+
+    struct traced {
+        int id;
+    };
+}
+
+namespace phamphilong {
+    template <>
+    struct radix_score<entry> {
+        using score_type = std::uint32_t;
+
+        static score_type get(const entry& value) {
+            return value.score;
+        }
+    };
+
+    template <>
+    struct radix_subtree_count<entry> : std::true_type {};
+
+    template <>
+    struct radix_count_events<traced> : std::true_type {};
+}
+
+using namespace phamphilong;
+
+namespace {
+    using tree_type = radix_tree<std::string, entry>;
+    using pool_tree_type = radix_tree<std::string, entry, split<std::string>, radix_len<std::string>,
+                                      radix_tree_pool_allocator<std::pair<const std::string, entry>>>;
+    using model_type = std::map<std::string, entry>;
+
+    std::string random_key(std::mt19937_64& rng) {
+        // mostly a few units so that keys share prefixes, one above 0x7f for the unsigned ordering of units, now and
+        // then any of the 256 so that nodes fan out through every children table layout
+        std::string key;
+        for (std::size_t len = rng() % 8; len > 0; --len) {
+            key += rng() % 4 == 0 ? static_cast<char>(rng()) : "ab\xff"[rng() % 3];
+        }
+        return key;
+    }
+
+    bool has_prefix(const std::string& key, const std::string& prefix) {
+        return key.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    template <typename Tree>
+    bool same_position(const Tree& tree, const typename Tree::iterator& it, const model_type& model, model_type::const_iterator entry) {
+        if (entry == model.end()) {
+            return it == tree.end();
+        }
+        return it != tree.end() && it.key() == entry->first && it->second == entry->second;
+    }
+
+    template <typename Tree>
+    bool same_entries(const Tree& tree, const model_type& model) {
+        auto it = tree.begin();
+        for (auto entry = model.begin(); entry != model.end(); ++entry, ++it) {
+            if (!same_position(tree, it, model, entry)) {
+                return false;
+            }
+        }
+        return it == tree.end() && tree.size() == model.size();
+    }
+
+    template <typename Tree>
+    void check_queries(const Tree& tree, const model_type& model, const std::string& key) {
+        RADIX_TREE_CHECK(same_position(tree, tree.find(key), model, model.find(key)));
+        RADIX_TREE_CHECK(same_position(tree, tree.lower_bound(key), model, model.lower_bound(key)));
+        RADIX_TREE_CHECK(same_position(tree, tree.upper_bound(key), model, model.upper_bound(key)));
+
+        // keys starting with key, in order, also cut short by a limit
+        const typename Tree::size_type limit = key.size();
+        std::size_t count = 0;
+        auto it = tree.find_with_prefix(key).begin();
+        auto limited = tree.find_with_prefix(key, limit).begin();
+        auto entry = model.lower_bound(key);
+        for (; entry != model.end() && has_prefix(entry->first, key); ++entry, ++it, ++count) {
+            RADIX_TREE_CHECK(same_position(tree, it, model, entry));
+            if (count < limit) {
+                RADIX_TREE_CHECK(same_position(tree, limited, model, entry));
+                ++limited;
+            }
+        }
+        RADIX_TREE_CHECK(it == tree.find_with_prefix(key).end());
+        RADIX_TREE_CHECK(limited == tree.find_with_prefix(key, limit).end());
+        RADIX_TREE_CHECK(tree.count_with_prefix(key) == count);
+
+        // rank is the number of smaller keys, select its inverse
+        auto rank = static_cast<std::size_t>(std::distance(model.begin(), model.lower_bound(key)));
+        RADIX_TREE_CHECK(tree.rank(key) == rank);
+        RADIX_TREE_CHECK(same_position(tree, tree.select(rank), model, model.lower_bound(key)));
+
+        // best scores first, the keys behind tied scores may come in any order
+        const typename Tree::size_type k = 1 + key.size() % 4;
+        std::vector<std::uint32_t> expected;
+        for (entry = model.lower_bound(key); entry != model.end() && has_prefix(entry->first, key); ++entry) {
+            expected.push_back(entry->second.score);
+        }
+        std::sort(expected.begin(), expected.end(), std::greater<std::uint32_t>());
+        expected.resize(std::min<std::size_t>(expected.size(), k));
+        std::vector<std::uint32_t> scores;
+        std::set<std::string> keys;
+        for (auto& best : tree.top_k_with_prefix(key, k)) {
+            entry = model.find(best.key());
+            RADIX_TREE_CHECK(has_prefix(best.key(), key) && entry != model.end() && best->second == entry->second);
+            RADIX_TREE_CHECK(keys.insert(best.key()).second);
+            scores.push_back(best->second.score);
+        }
+        RADIX_TREE_CHECK(scores == expected);
+    }
+
+    template <typename Tree>
+    void check_stats(const Tree& tree, const model_type& model) {
+        // the shape of a radix tree of these keys: a node for the root, every key and every unit where neighbours in
+        // key order part, below the longest of those nodes that is a prefix of it
+        std::set<std::string> nodes{""};
+        for (auto entry = model.begin(); entry != model.end(); ++entry) {
+            nodes.insert(entry->first);
+            if (entry != model.begin()) {
+                const std::string& previous = std::prev(entry)->first;
+                auto parted = std::mismatch(previous.begin(), previous.end(), entry->first.begin(), entry->first.end());
+                nodes.insert(std::string(previous.begin(), parted.first));
+            }
+        }
+
+        radix_tree_stats expected;
+        std::map<std::string, std::size_t> fanouts;
+        std::vector<std::pair<std::string, std::size_t>> path;       // ancestors of the current node, with their depth
+        for (auto& node : nodes) {
+            while (!path.empty() && !has_prefix(node, path.back().first)) {
+                path.pop_back();
+            }
+            std::size_t depth = path.empty() ? 0 : path.back().second + 1;
+            expected.node_count++;
+            if (model.count(node) != 0) {
+                expected.value_count++;
+                expected.value_bytes += sizeof(entry);
+            } else if (!path.empty()) {
+                expected.split_node_count++;
+            }
+            if (!path.empty()) {
+                std::size_t label_len = node.size() - path.back().first.size();
+                fanouts[path.back().first]++;
+                expected.total_label_length += label_len;
+                if (label_len > 24) {
+                    expected.heap_label_count++;
+                    expected.label_bytes += label_len;
+                }
+            }
+            expected.max_depth = std::max(expected.max_depth, depth);
+            expected.depth_histogram.resize(std::max(expected.depth_histogram.size(), depth + 1));
+            expected.depth_histogram[depth]++;
+            path.emplace_back(node, depth);
+        }
+        for (auto& node : nodes) {
+            std::size_t fanout = fanouts[node];
+            expected.leaf_count += fanout == 0 ? 1 : 0;
+            expected.fanout_histogram.resize(std::max(expected.fanout_histogram.size(), fanout + 1));
+            expected.fanout_histogram[fanout]++;
+        }
+
+        radix_tree_stats stats = tree.stats();
+        RADIX_TREE_CHECK(stats.node_count == expected.node_count && stats.value_count == expected.value_count);
+        RADIX_TREE_CHECK(stats.leaf_count == expected.leaf_count && stats.split_node_count == expected.split_node_count);
+        RADIX_TREE_CHECK(stats.max_depth == expected.max_depth && stats.total_label_length == expected.total_label_length);
+        RADIX_TREE_CHECK(stats.heap_label_count == expected.heap_label_count && stats.label_bytes == expected.label_bytes);
+        RADIX_TREE_CHECK(stats.fanout_histogram == expected.fanout_histogram);
+        RADIX_TREE_CHECK(stats.depth_histogram == expected.depth_histogram);
+        RADIX_TREE_CHECK(stats.value_bytes == expected.value_bytes);
+        RADIX_TREE_CHECK(stats.node_bytes % expected.node_count == 0);     // nodes all have the same size
+        RADIX_TREE_CHECK(stats.total_bytes() == stats.node_bytes + stats.children_bytes + stats.value_bytes + stats.label_bytes);
+    }
+
+    template <typename Tree>
+    void check_find_batch(const Tree& tree, const model_type& model, std::mt19937_64& rng) {
+        // interleaved lookups give what find() gives, in order, for batches around the group size too
+        for (std::size_t batch_size : {0, 1, 15, 16, 17, 33, 500}) {
+            std::vector<std::string> keys;
+            for (std::size_t i = 0; i < batch_size; ++i) {
+                auto stored = model.lower_bound(random_key(rng));
+                keys.push_back(stored != model.end() && rng() % 2 == 0 ? stored->first : random_key(rng));
+            }
+            std::vector<typename Tree::iterator> results;
+            tree.find_batch(keys.begin(), keys.end(), std::back_inserter(results));
+            RADIX_TREE_CHECK(results.size() == batch_size);
+            for (std::size_t i = 0; i < results.size(); ++i) {
+                RADIX_TREE_CHECK(same_position(tree, results[i], model, model.find(keys[i])));
+            }
+        }
+    }
+
+    std::size_t edit_distance(const std::string& lhs, const std::string& rhs) {
+        // Levenshtein distance, one row at a time
+        std::vector<std::size_t> row(rhs.size() + 1);
+        std::iota(row.begin(), row.end(), 0);
+        for (std::size_t i = 1; i <= lhs.size(); ++i) {
+            std::size_t diagonal = row[0];
+            row[0] = i;
+            for (std::size_t j = 1; j <= rhs.size(); ++j) {
+                std::size_t above = row[j];
+                row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + (lhs[i - 1] == rhs[j - 1] ? 0 : 1)});
+                diagonal = above;
+            }
+        }
+        return row[rhs.size()];
+    }
+
+    template <typename Tree>
+    void check_find_fuzzy(const Tree& tree, const model_type& model, std::mt19937_64& rng) {
+        // every key within the distance, by distance then in key order, cut at the limit
+        for (std::size_t max_distance = 0; max_distance <= 3; ++max_distance) {
+            std::string key = random_key(rng);
+            std::vector<std::pair<std::size_t, std::string>> expected;
+            for (auto& entry : model) {
+                std::size_t distance = edit_distance(key, entry.first);
+                if (distance <= max_distance) {
+                    expected.emplace_back(distance, entry.first);
+                }
+            }
+            std::stable_sort(expected.begin(), expected.end(), [](auto& lhs, auto& rhs) {
+                return lhs.first < rhs.first;
+            });
+
+            for (std::size_t limit : {Tree::no_limit, std::size_t{0}, std::size_t{1}, std::size_t{5}}) {
+                auto matches = tree.find_fuzzy(key, max_distance, limit);
+                RADIX_TREE_CHECK(matches.size() == std::min(limit, expected.size()));
+                for (std::size_t i = 0; i < matches.size() && i < expected.size(); ++i) {
+                    RADIX_TREE_CHECK(matches[i].distance == expected[i].first);
+                    RADIX_TREE_CHECK(same_position(tree, matches[i].position, model, model.find(expected[i].second)));
+                }
+            }
+        }
+    }
+
+    template <typename Tree>
+    void check_against_map() {
+        std::mt19937_64 rng{3};
+        Tree tree;
+        model_type model;
+        auto hint = tree.end();
+        for (int step = 0; step < 30000; ++step) {
+            std::string key = random_key(rng);
+            entry value{static_cast<std::uint32_t>(rng() % 16), step};
+            switch (rng() % 6) {
+                case 0:
+                    RADIX_TREE_CHECK(tree.insert({key, value}).second == model.insert({key, value}).second);
+                    break;
+                case 1:
+                    // any position is a valid hint, a good one only makes it faster
+                    hint = tree.insert(hint, {key, value});
+                    model.insert({key, value});
+                    RADIX_TREE_CHECK(hint != tree.end() && hint.key() == key && hint->second == model.at(key));
+                    break;
+                case 2:
+                    RADIX_TREE_CHECK(tree.insert_or_assign(key, value).second == model.insert_or_assign(key, value).second);
+                    break;
+                default:
+                    RADIX_TREE_CHECK(tree.erase(key) == model.erase(key));
+                    break;
+            }
+            if (rng() % 4 == 0) {
+                // erase invalidates, a fresh hint from a lookup keeps the hinted inserts honest
+                hint = tree.find(random_key(rng));
+            } else if (hint != tree.end() && model.count(hint.key()) == 0) {
+                hint = tree.end();
+            }
+            RADIX_TREE_CHECK(tree.size() == model.size());
+            check_queries(tree, model, random_key(rng));
+
+            if (step % 1000 == 999) {
+                check_find_batch(tree, model, rng);
+                check_find_fuzzy(tree, model, rng);
+                check_stats(tree, model);
+            }
+            if (step % 5000 == 4999) {
+                RADIX_TREE_CHECK(same_entries(tree, model));
+                tree.compact();
+                hint = tree.end();
+                RADIX_TREE_CHECK(same_entries(tree, model));
+            }
+        }
+
+        for (const char* key : {"", "a", "ab", "b\xff", "\xff\xff", "aaaaaaaa"}) {
+            check_queries(tree, model, key);
+        }
+        // the random keys fanned some node out past node48
+        RADIX_TREE_CHECK(tree.stats().fanout_histogram.size() > 49);
+    }
+
+    template <typename Tree>
+    void check_fanout() {
+        // a node through every table layout and back, at the root and below, children added and removed in any order
+        std::mt19937_64 rng{31};
+        Tree tree;
+        model_type model;
+        std::vector<int> units(256);
+        std::iota(units.begin(), units.end(), 0);
+        for (const std::string prefix : {"", "fan/"}) {
+            for (int round = 0; round < 4; ++round) {
+                const std::string tail = round % 2 == 0 ? "" : "/tail";
+                std::shuffle(units.begin(), units.end(), rng);
+                for (int unit : units) {
+                    std::string key = prefix + static_cast<char>(unit) + tail;
+                    entry value{static_cast<std::uint32_t>(rng() % 16), unit};
+                    RADIX_TREE_CHECK(tree.insert({key, value}).second == model.insert({key, value}).second);
+                    RADIX_TREE_CHECK(same_entries(tree, model));
+                    check_queries(tree, model, prefix + static_cast<char>(rng()));
+                }
+                check_queries(tree, model, prefix);
+                RADIX_TREE_CHECK(tree.stats().fanout_histogram.size() == 257);
+                check_stats(tree, model);
+
+                // erasing from node48 moves the last child into the hole, from node256 it only clears a slot
+                std::shuffle(units.begin(), units.end(), rng);
+                for (int unit : units) {
+                    std::string key = prefix + static_cast<char>(unit) + tail;
+                    RADIX_TREE_CHECK(tree.erase(key) == model.erase(key));
+                    RADIX_TREE_CHECK(same_entries(tree, model));
+                    check_queries(tree, model, prefix + static_cast<char>(rng()));
+                }
+                check_queries(tree, model, prefix);
+            }
+        }
+    }
+
+    void check_assign() {
+        // sorted input is loaded in one pass, unsorted input falls back to inserts, both end up the same
+        std::mt19937_64 rng{5};
+        model_type model;
+        std::vector<std::pair<std::string, entry>> shuffled;
+        for (int i = 0; i < 5000; ++i) {
+            std::string key = random_key(rng);
+            entry value{static_cast<std::uint32_t>(rng() % 16), i};
+            if (model.insert({key, value}).second) {
+                shuffled.emplace_back(key, value);
+            }
+        }
+
+        tree_type sorted_tree;
+        sorted_tree.assign(model.begin(), model.end());
+        RADIX_TREE_CHECK(same_entries(sorted_tree, model));
+        tree_type unsorted_tree;
+        unsorted_tree.assign(shuffled.begin(), shuffled.end());
+        RADIX_TREE_CHECK(same_entries(unsorted_tree, model));
+        for (int i = 0; i < 200; ++i) {
+            std::string key = random_key(rng);
+            check_queries(sorted_tree, model, key);
+            check_queries(unsorted_tree, model, key);
+        }
+    }
+
+    void check_pool() {
+        // blocks of every size class and large blocks come back to the pool for reuse, clear() drops the pool at once
+        std::mt19937_64 rng{37};
+        pool_tree_type tree;
+        model_type model;
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < 3000; ++i) {
+                std::string key = random_key(rng) + std::string(rng() % 64 == 0 ? 5000 + rng() % 100 : rng() % 40, 'x');
+                entry value{static_cast<std::uint32_t>(rng() % 16), i};
+                if (rng() % 3 != 0) {
+                    RADIX_TREE_CHECK(tree.insert({key, value}).second == model.insert({key, value}).second);
+                } else {
+                    auto stored = model.lower_bound(key);
+                    key = stored != model.end() ? stored->first : key;
+                    RADIX_TREE_CHECK(tree.erase(key) == model.erase(key));
+                }
+            }
+            RADIX_TREE_CHECK(same_entries(tree, model));
+            check_queries(tree, model, "a");
+            tree.compact();
+            RADIX_TREE_CHECK(same_entries(tree, model));
+
+            tree.clear();
+            model.clear();
+            RADIX_TREE_CHECK(tree.get_allocator().get_pool()->chunk_count() == 0);
+            RADIX_TREE_CHECK(tree.get_allocator().get_pool()->allocated_bytes() == 0);
+        }
+    }
+
+    // allocations left before the next one throws, no limit if negative
+    long allocation_budget = -1;
+
+    template <typename U>
+    struct failing_allocator {
+        using value_type = U;
+
+        failing_allocator() = default;
+        template <typename V> failing_allocator(const failing_allocator<V>&) noexcept {}
+
+        U* allocate(const std::size_t n) {
+            if (allocation_budget == 0) {
+                throw std::bad_alloc();
+            }
+            if (allocation_budget > 0) {
+                --allocation_budget;
+            }
+            return std::allocator<U>().allocate(n);
+        }
+
+        void deallocate(U* p, const std::size_t n) noexcept {
+            std::allocator<U>().deallocate(p, n);
+        }
+
+        template <typename V> bool operator== (const failing_allocator<V>&) const noexcept {
+            return true;
+        }
+        template <typename V> bool operator!= (const failing_allocator<V>&) const noexcept {
+            return false;
+        }
+    };
+
+    using failing_tree_type = radix_tree<std::string, entry, split<std::string>, radix_len<std::string>, failing_allocator<entry>>;
+
+    void check_failing_allocator() {
+        // an insert or erase that throws leaves the tree as it was, entries, counts, scores and size
+        std::mt19937_64 rng{23};
+        failing_tree_type tree;
+        model_type model;
+        std::size_t failed = 0;
+        for (int step = 0; step < 20000; ++step) {
+            // labels longer than fit in a node once merged, and any unit where keys part so that tables grow and shrink
+            std::string key(26 + rng() % 8, "abc"[rng() % 3]);
+            for (std::size_t changes = rng() % 3; changes > 0; --changes) {
+                key[rng() % key.size()] = static_cast<char>(rng());
+            }
+            entry value{static_cast<std::uint32_t>(rng() % 16), step};
+
+            allocation_budget = rng() % 4 == 0 ? -1 : static_cast<long>(rng() % 4);
+            try {
+                if (rng() % 3 != 0) {
+                    if (tree.insert({key, value}).second) {
+                        model.insert({key, value});
+                    }
+                } else {
+                    // mostly a stored key, whose erase merges nodes
+                    auto stored = model.lower_bound(key);
+                    if (stored != model.end() && rng() % 4 != 0) {
+                        key = stored->first;
+                    }
+                    auto erased = tree.erase(key);
+                    RADIX_TREE_CHECK(erased == model.erase(key));
+                }
+            } catch (const std::bad_alloc&) {
+                ++failed;
+            }
+            allocation_budget = -1;
+
+            RADIX_TREE_CHECK(tree.size() == model.size());
+            if (step % 1000 == 999) {
+                RADIX_TREE_CHECK(same_entries(tree, model));
+                check_queries(tree, model, key.substr(0, rng() % key.size()));
+            }
+        }
+        RADIX_TREE_CHECK(failed > 0);
+        RADIX_TREE_CHECK(same_entries(tree, model));
+    }
+
+    void check_failing_assign() {
+        // an assign that throws leaves an empty tree and frees every node it built so far
+        std::mt19937_64 rng{29};
+        model_type model;
+        for (int i = 0; i < 2000; ++i) {
+            std::string key(26 + rng() % 8, "abc"[rng() % 3]);
+            key[rng() % key.size()] = static_cast<char>(rng());
+            model.insert({key, entry{static_cast<std::uint32_t>(rng() % 16), i}});
+        }
+
+        std::size_t failed = 0;
+        for (long budget = 0; budget < 6000; budget += 1 + budget / 8) {
+            failing_tree_type tree;
+            allocation_budget = budget;
+            try {
+                tree.assign(model.begin(), model.end());
+            } catch (const std::bad_alloc&) {
+                ++failed;
+            }
+            allocation_budget = -1;
+            RADIX_TREE_CHECK(tree.size() == 0 || same_entries(tree, model));
+            RADIX_TREE_CHECK(tree.size() != 0 || tree.begin() == tree.end());
+        }
+        RADIX_TREE_CHECK(failed > 0);
+    }
+
+    void check_counters() {
+        // counted only for value types that turn them on, the others keep a tree without room for them
+        RADIX_TREE_CHECK(sizeof(radix_tree<std::string, int>) < sizeof(radix_tree<std::string, traced>));
+        radix_tree<std::string, int> plain;
+        plain.insert({"ab", 1});
+        plain.insert({"ac", 2});
+        RADIX_TREE_CHECK(plain.counters().lookups == 0 && plain.counters().insert_splits == 0);
+
+        radix_tree<std::string, traced> tree;
+        tree.insert({"ab", traced{1}});
+        tree.insert({"ac", traced{2}});
+        RADIX_TREE_CHECK(tree.counters().insert_splits == 1);
+        RADIX_TREE_CHECK(tree.find("ab") != tree.end() && tree.find("ad") == tree.end());
+        RADIX_TREE_CHECK(tree.counters().lookups == 2 && tree.counters().lookup_steps > 2);
+        RADIX_TREE_CHECK(tree.erase("ab") == 1 && tree.counters().erase_merges == 1 && tree.counters().lookups == 3);
+        tree.reset_counters();
+        RADIX_TREE_CHECK(tree.counters().lookups == 0 && tree.counters().lookup_steps == 0);
+        RADIX_TREE_CHECK(tree.counters().insert_splits == 0 && tree.counters().erase_merges == 0);
+    }
+
+    void check_deep_tree() {
+        // a chain of nodes as deep as the keys are long
+        tree_type tree;
+        model_type model;
+        std::string key;
+        for (int i = 0; i < 20000; ++i) {
+            key += 'a';
+            if (i % 2 == 0) {
+                tree.insert({key, entry{static_cast<std::uint32_t>(i % 7), i}});
+                model.insert({key, entry{static_cast<std::uint32_t>(i % 7), i}});
+            }
+        }
+        RADIX_TREE_CHECK(tree.erase(std::string(10001, 'a')) == model.erase(std::string(10001, 'a')));
+        RADIX_TREE_CHECK(same_entries(tree, model));
+        check_stats(tree, model);
+        check_queries(tree, model, std::string(5000, 'a'));
+        std::vector<std::string> keys{std::string(9999, 'a'), std::string(10000, 'a'), std::string(10001, 'a'), std::string(20000, 'a')};
+        std::vector<tree_type::iterator> results;
+        tree.find_batch(keys.begin(), keys.end(), std::back_inserter(results));
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            RADIX_TREE_CHECK(same_position(tree, results[i], model, model.find(keys[i])));
+        }
+        tree.compact();
+        RADIX_TREE_CHECK(same_entries(tree, model));
+    }
+}
+
+int main() {
+    check_against_map<tree_type>();
+    check_against_map<pool_tree_type>();
+    check_fanout<tree_type>();
+    check_fanout<pool_tree_type>();
+    check_pool();
+    check_assign();
+    check_deep_tree();
+    check_counters();
+    check_failing_allocator();
+    check_failing_assign();
+    return phamphilong_test::report("radix_tree_test");
+}